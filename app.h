@@ -0,0 +1,309 @@
+#ifndef APP_H
+#define APP_H
+
+#include "game.h"
+
+class Game : public Window
+{
+protected:
+    enum class State
+    {
+        InGame,
+        MainMenu,
+        EndFail,
+        Market,
+        PauseMenu,
+        QuitGame
+    };
+    Character character;
+    WaveSystem waveController;
+    Decal mapDecal;
+    Chest chest;
+    DataNode config;
+    MenuManager<Game::State> menuManager;
+    Game::State currGameState = Game::State::MainMenu;
+    Decal menuBgDecal;
+    SpriteBatch sprBatch;
+    Market market;
+    Menu<Game::State> mainMenu;
+    Menu<Game::State> gameOverMenu;
+    Menu<Game::State> pauseMenu;
+    bool showMemoryStats = false;
+    IdleRenderer idleRenderer;
+    LayerCompositor compositor;
+    DrawQueue drawQueue;
+    SaveWorker saveWorker;
+    InputSampler inputSampler;
+#ifdef INSTANCED_SPRITES
+    InstancedSpriteBatch instancedSprites;
+#endif
+public:
+#ifdef INSTANCED_SPRITES
+    bool instancedSpritesEnabled = true;
+#endif
+    inline void UserStart() override
+    {
+        srand(time(0));
+        waveController.rng.seed(rand());
+        chest.rng.seed(rand());
+        sprBatch = SpriteBatch(this);
+#ifdef INSTANCED_SPRITES
+        if(instancedSpritesEnabled && instancedSprites.Init(GetScreenSize())) instancedBatch = &instancedSprites;
+#endif
+        inputSampler.Attach(GetHandle());
+        {
+            MemoryScope scope(MemoryTag::Config);
+            Deserialize(config, "datafile.txt");
+        }
+        for(std::size_t i = 0; i < memoryTagCount; i++)
+        {
+            const MemoryTag tag = static_cast<MemoryTag>(i);
+            memoryTracker.SetCeiling(tag, GetData<int>(config["memory"]["ceiling"][GetMemoryTagName(tag)], 0).value_or(0));
+        }
+        saveWorker.Start("datafile.txt");
+        character = Character();
+        character.Deserialize(config);
+        {
+            MemoryScope scope(MemoryTag::Textures);
+            mapDecal = Decal("assets\\misc\\map.png");
+            menuBgDecal = Decal("assets\\UI\\menu\\background.png");
+        }
+        MemoryScope scope(MemoryTag::UI);
+        mainMenu["Start"].SetId(Game::State::InGame);
+        mainMenu["Market"].SetId(Game::State::Market);
+        mainMenu["Quit"]["No"].SetId(Game::State::MainMenu);
+        mainMenu["Quit"]["Yes"].SetId(Game::State::QuitGame);
+        mainMenu["Quit"].SetTableSize(2, 1);
+        mainMenu.SetPos(30.0f, 250.0f);
+        mainMenu.SetTableSize(1, 3);
+        mainMenu.SetScale(4.0f);
+        mainMenu.Build();
+        market.pos = GetScreenSize() * 0.5f;
+        market.size = 5.0f;
+        market.Deserialize(config);
+        gameOverMenu["Retry"].SetId(Game::State::InGame);
+        gameOverMenu["Main Menu"].SetId(Game::State::MainMenu);
+        gameOverMenu.SetPos(GetScreenSize() * 0.5f);
+        gameOverMenu.SetOrigin(0.5f, 0.0f);
+        gameOverMenu.SetTableSize(1, 2);
+        gameOverMenu.SetScale(4.0f);
+        gameOverMenu.Build();
+        pauseMenu["Main Menu"].SetId(Game::State::MainMenu);
+        pauseMenu["Resume"].SetId(Game::State::InGame);
+        pauseMenu.SetPos(GetScreenSize() * 0.5f);
+        pauseMenu.SetOrigin(0.5f, 0.0f);
+        pauseMenu.SetTableSize(1, 2);
+        pauseMenu.SetScale(4.0f);
+        pauseMenu.Build();
+        waveController.Reset();
+        menuManager.SetWindowHandle(this);
+        menuManager.Close();
+        Restart();
+    }
+    inline void Restart()
+    {
+        market.ResetCharacter(character);
+        character.SetDefault();
+        waveController.Reset();
+        chest.Reset();
+    }
+    inline void UserUpdate() override
+    {
+        memoryTracker.Update(GetDeltaTime());
+        const InputState& input = inputSampler.Poll();
+        if(GetKey(GLFW_KEY_F3) == Key::Pressed)
+        {
+            showMemoryStats = !showMemoryStats;
+            compositor.Invalidate();
+        }
+        if(showMemoryStats)
+        {
+            idleRenderer.Invalidate();
+            compositor.Invalidate();
+        }
+        const Game::State prevGameState = currGameState;
+        switch(currGameState)
+        {
+            case Game::State::MainMenu: MenuDrawAndUpdate(); break;
+            case Game::State::InGame: MainDrawAndUpdate(input); break;
+            case Game::State::Market: MarketDrawAndUpdate(input); break;
+            case Game::State::EndFail: EndFailDrawAndUpdate(); break;
+            case Game::State::PauseMenu: PauseDrawAndUpdate(); break;
+        }
+        if(showMemoryStats)
+        {
+            DrawMemoryStats(this, GetWidth() - 300.0f, 10.0f);
+            DrawQueueStats(this, GetWidth() - 300.0f, 10.0f + memoryTagCount * 20.0f, drawQueue);
+        }
+        FlushBatches();
+        if(currGameState != prevGameState)
+        {
+            idleRenderer.Invalidate();
+            compositor.Invalidate();
+        }
+        else if(IsIdleState(currGameState)) idleRenderer.Wait();
+    }
+    inline void FlushBatches()
+    {
+        sprBatch.Flush();
+#ifdef INSTANCED_SPRITES
+        if(instancedBatch) instancedBatch->Flush();
+#endif
+    }
+    inline bool IsIdleState(Game::State state)
+    {
+        return state == Game::State::MainMenu || state == Game::State::Market ||
+            state == Game::State::EndFail || state == Game::State::PauseMenu;
+    }
+    inline void MenuDrawAndUpdate()
+    {
+//Update
+        if(menuManager.Empty()) menuManager.Open(mainMenu);
+        std::optional<Game::State> state = menuManager.Update();
+        if(state.has_value())
+            switch(state.value())
+            {
+                case Game::State::InGame:
+                {
+                    Restart();
+                    menuManager.Close();
+                    currGameState = Game::State::InGame;
+                }
+                break;
+                case Game::State::QuitGame:
+                {
+                    glfwSetWindowShouldClose(GetHandle(), GL_TRUE);
+                }
+                break;
+                case Game::State::Market:
+                {
+                    menuManager.Close();
+                    currGameState = Game::State::Market;
+                }
+                break;
+                case Game::State::MainMenu:
+                {
+                    menuManager.MoveBack();
+                }
+                break;
+                default: break;
+            }
+//Draw
+        if(idleRenderer.BeginFrame(this))
+        {
+            Clear(Colors::Black);
+            menuManager.Draw();
+        }
+        sprBatch.Draw(menuBgDecal, GetViewport());
+    }
+    inline void MarketDrawAndUpdate(const InputState& input)
+    {
+//Update
+        if(input.IsPressed(GLFW_KEY_ESCAPE)) currGameState = Game::State::MainMenu;
+        if(market.Update(character, input)) Autosave();
+//Draw
+        if(!idleRenderer.BeginFrame(this)) return;
+        Clear(Colors::Black);
+        SetPixelMode(PixelMode::Alpha);
+        market.Draw(character, this);
+        SetPixelMode(PixelMode::Normal);
+    }
+    inline void MainDrawAndUpdate(const InputState& input)
+    {
+        MainUpdate(input, GetDeltaTime());
+        MainDraw();
+    }
+    inline void MainUpdate(const InputState& input, float dt)
+    {
+        if(input.IsPressed(GLFW_KEY_ESCAPE)) currGameState = Game::State::PauseMenu;
+        if(character.health <= 0) currGameState = Game::State::EndFail;
+        character.Update(input, dt);
+        waveController.Update(dt, character);
+        if(waveController.waveCompleted) Autosave();
+        chest.Update(character, input, dt);
+    }
+    inline void MainDraw()
+    {
+        sprBatch.Draw(mapDecal, GetViewport());
+        compositor.Begin(this);
+        chest.Draw(character, this, compositor);
+        SetPixelMode(PixelMode::Alpha);
+        drawQueue.Begin(this);
+        character.Enqueue(drawQueue);
+#ifdef INSTANCED_SPRITES
+        chest.Enqueue(drawQueue);
+#endif
+        waveController.Enqueue(drawQueue);
+        drawQueue.Submit(this, compositor);
+        character.DrawHud(this, compositor);
+        waveController.DrawHud(this, compositor);
+        SetPixelMode(PixelMode::Normal);
+        compositor.End();
+    }
+    inline void PauseDrawAndUpdate()
+    {
+//Update
+        if(menuManager.Empty()) menuManager.Open(pauseMenu);
+        std::optional<Game::State> state = menuManager.Update();
+        if(state.has_value())
+            switch(state.value())
+            {
+                case Game::State::InGame: case Game::State::MainMenu:
+                {
+                    menuManager.Close();
+                    currGameState = state.value();
+                }
+                break;
+                default: break;
+            }
+//Draw
+        if(!idleRenderer.BeginFrame(this)) return;
+        Clear(Colors::Black);
+        DrawText(GetWidth() * 0.5f, 100, "PAUSED", 4.0f, Colors::White, 0.5f);
+        menuManager.Draw();
+    }
+    inline void EndFailDrawAndUpdate()
+    {
+//Update
+        if(menuManager.Empty()) menuManager.Open(gameOverMenu);
+        std::optional<Game::State> state = menuManager.Update();
+        if(state.has_value())
+            switch(state.value())
+            {
+                case Game::State::InGame:
+                {
+                    Restart();
+                    menuManager.Close();
+                    currGameState = Game::State::InGame;
+                }
+                break;
+                case Game::State::MainMenu:
+                {
+                    menuManager.Close();
+                    currGameState = Game::State::MainMenu;
+                }
+                break;
+                default: break;
+            }
+//Draw
+        if(!idleRenderer.BeginFrame(this)) return;
+        Clear(Colors::Black);
+        DrawText(GetWidth() * 0.5, 100, "Defeat", 6.0f, Colors::White, 0.5f);
+        menuManager.Draw();
+    }
+    inline void Autosave()
+    {
+        MemoryScope scope(MemoryTag::Config);
+        character.Serialize(config);
+        market.Serialize(config);
+        saveWorker.Submit(config);
+    }
+    inline void Terminate()
+    {
+        Autosave();
+        saveWorker.Stop();
+        waveController.Reset();
+    }
+};
+
+#endif
@@ -0,0 +1,242 @@
+#define STB_IMAGE_IMPLEMENTATION
+#define NO_COLLISIONS
+#define VERTEX_COLOR
+#define INSTANCED_SPRITES
+#include "app.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+struct BenchConfig
+{
+    std::vector<int> scenes = {10, 100, 1000};
+    int warmupFrames = 30;
+    int frames = 300;
+    int captureFrame = 1;
+    int width = 1024, height = 768;
+    uint32_t seed = 1;
+    float step = 1.0f / 60.0f;
+    float tolerance = 0.0f;
+    bool headless = true;
+    bool instanced = false;
+    bool writeGolden = false;
+    std::string goldenDir;
+    std::string outPath = "bench_frames.csv";
+};
+
+struct FrameStats
+{
+    double mean, p50, p95, p99, max;
+};
+
+inline FrameStats GetFrameStats(std::vector<double> samples)
+{
+    if(samples.empty()) return {0.0, 0.0, 0.0, 0.0, 0.0};
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p){return samples[std::min<std::size_t>(samples.size() - 1, p * samples.size())];};
+    const double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    return {mean, percentile(0.5), percentile(0.95), percentile(0.99), samples.back()};
+}
+
+inline bool WritePPM(const std::string& path, int width, int height, const std::vector<uint8_t>& pixels)
+{
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if(!file) return false;
+    std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for(int y = height - 1; y >= 0; y--)
+        for(int x = 0; x < width; x++)
+            std::fwrite(&pixels[(y * width + x) * 4], 1, 3, file);
+    std::fclose(file);
+    return true;
+}
+
+inline bool ReadPPM(const std::string& path, int& width, int& height, std::vector<uint8_t>& rgb)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if(!file) return false;
+    int maxValue = 0;
+    const bool valid = std::fscanf(file, "P6 %d %d %d", &width, &height, &maxValue) == 3 && std::fgetc(file) != EOF;
+    if(valid)
+    {
+        rgb.resize(width * height * 3);
+        rgb.resize(std::fread(rgb.data(), 1, rgb.size(), file));
+    }
+    std::fclose(file);
+    return valid && rgb.size() == static_cast<std::size_t>(width * height * 3);
+}
+
+class Benchmark : public Game
+{
+public:
+    BenchConfig config;
+    std::size_t currScene = 0;
+    int frame = 0;
+    double lastFrameStart = 0.0;
+    std::vector<double> drawTimes, frameTimes;
+    std::FILE* log = nullptr;
+    bool passed = true;
+    inline void UserStart() override
+    {
+        instancedSpritesEnabled = config.instanced;
+        Game::UserStart();
+        if(config.instanced && !instancedBatch) std::cerr << "instanced sprites unavailable, using the pixel path\n";
+        glfwSwapInterval(0);
+        log = std::fopen(config.outPath.c_str(), "w");
+        if(log) std::fprintf(log, "enemies,frame,draw_ms,frame_ms\n");
+        StartScene();
+    }
+    inline void StartScene()
+    {
+        Restart();
+        currGameState = Game::State::InGame;
+        compositor.Invalidate();
+        character.modifiers.Add({Stat::DamageTaken, 0.0f, 0.0f, -1.0f, ModifierSource::Powerup});
+        std::minstd_rand rng(config.seed);
+        waveController.rng.seed(config.seed);
+        chest.rng.seed(config.seed);
+        const int enemies = config.scenes[currScene];
+        for(int i = 0; i < enemies; i++)
+            waveController.enemies.Spawn(static_cast<EnemyType>(i % enemyTypeCount), RandomPoint(rng, mapBound));
+        waveController.currentWave = waveController.enemiesSpawned = enemies;
+        waveController.spawnSysState = SpawnSystemState::Spawning;
+        drawTimes.clear();
+        frameTimes.clear();
+        frame = 0;
+        lastFrameStart = glfwGetTime();
+    }
+    inline void UserUpdate() override
+    {
+        const double frameStart = glfwGetTime();
+        if(frame == config.captureFrame + 1) CaptureGolden();
+        MainUpdate(inputSampler.Poll(), config.step);
+        currGameState = Game::State::InGame;
+        const double drawStart = glfwGetTime();
+        MainDraw();
+        FlushBatches();
+        glFinish();
+        const double drawEnd = glfwGetTime();
+        if(frame >= config.warmupFrames)
+        {
+            drawTimes.push_back((drawEnd - drawStart) * 1000.0);
+            frameTimes.push_back((frameStart - lastFrameStart) * 1000.0);
+            if(log) std::fprintf(log, "%d,%d,%.4f,%.4f\n", config.scenes[currScene], frame, drawTimes.back(), frameTimes.back());
+        }
+        lastFrameStart = frameStart;
+        if(++frame < config.warmupFrames + config.frames) return;
+        Report();
+        if(++currScene < config.scenes.size()) StartScene();
+        else glfwSetWindowShouldClose(GetHandle(), GL_TRUE);
+    }
+    inline void CaptureGolden()
+    {
+        if(config.goldenDir.empty()) return;
+        const int width = GetWidth(), height = GetHeight();
+        std::vector<uint8_t> pixels(width * height * 4);
+        glReadBuffer(GL_FRONT);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        const std::string path = config.goldenDir + "/scene-" + std::to_string(config.scenes[currScene]) +
+            (instancedBatch ? "-instanced" : "") + ".ppm";
+        if(config.writeGolden)
+        {
+            if(!WritePPM(path, width, height, pixels)) std::cerr << "could not write " << path << '\n';
+            return;
+        }
+        int goldenWidth = 0, goldenHeight = 0;
+        std::vector<uint8_t> golden;
+        if(!ReadPPM(path, goldenWidth, goldenHeight, golden) || goldenWidth != width || goldenHeight != height)
+        {
+            std::cerr << "missing or mismatched golden image " << path << '\n';
+            passed = false;
+            return;
+        }
+        double diff = 0.0;
+        for(int y = 0; y < height; y++)
+            for(int x = 0; x < width; x++)
+                for(int c = 0; c < 3; c++)
+                    diff += std::abs(pixels[(y * width + x) * 4 + c] - golden[((height - 1 - y) * width + x) * 3 + c]);
+        diff /= width * height * 3.0;
+        if(diff > config.tolerance)
+        {
+            std::cerr << path << ": mean channel difference " << diff << " exceeds " << config.tolerance << '\n';
+            passed = false;
+        }
+    }
+    inline void Report()
+    {
+        const FrameStats draw = GetFrameStats(drawTimes);
+        const FrameStats total = GetFrameStats(frameTimes);
+        std::printf("%6d enemies %s | draw ms mean %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f | frame ms mean %.3f p95 %.3f max %.3f\n",
+            config.scenes[currScene], instancedBatch ? "instanced" : "pixel", draw.mean, draw.p50, draw.p95, draw.p99, draw.max, total.mean, total.p95, total.max);
+    }
+    ~Benchmark()
+    {
+        if(log) std::fclose(log);
+    }
+};
+
+inline bool ParseArgs(int argc, char** argv, BenchConfig& config)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if(arg == "--windowed") config.headless = false;
+        else if(arg == "--write-golden") config.writeGolden = true;
+        else if(arg == "--instanced") config.instanced = true;
+        else if(i + 1 >= argc) return false;
+        else
+        {
+            const std::string value = argv[++i];
+            if(arg == "--enemies")
+            {
+                config.scenes.clear();
+                std::size_t begin = 0;
+                while(begin <= value.size())
+                {
+                    const std::size_t end = std::min(value.find(',', begin), value.size());
+                    config.scenes.push_back(std::stoi(value.substr(begin, end - begin)));
+                    begin = end + 1;
+                }
+            }
+            else if(arg == "--frames") config.frames = std::stoi(value);
+            else if(arg == "--warmup") config.warmupFrames = std::stoi(value);
+            else if(arg == "--capture-frame") config.captureFrame = std::stoi(value);
+            else if(arg == "--seed") config.seed = std::stoul(value);
+            else if(arg == "--step") config.step = std::stof(value);
+            else if(arg == "--tolerance") config.tolerance = std::stof(value);
+            else if(arg == "--golden") config.goldenDir = value;
+            else if(arg == "--out") config.outPath = value;
+            else return false;
+        }
+    }
+    return !config.scenes.empty() && config.step > 0.0f;
+}
+
+int main(int argc, char** argv)
+{
+    Benchmark benchmark;
+    bool parsed = false;
+    try
+    {
+        parsed = ParseArgs(argc, argv, benchmark.config);
+    }
+    catch(const std::logic_error&) {}
+    if(!parsed)
+    {
+        std::cerr << "usage: benchmark [--enemies 10,100,1000] [--frames N] [--warmup N] [--seed N] [--step S] [--windowed] [--instanced]"
+            " [--golden dir [--write-golden] [--capture-frame N] [--tolerance T]] [--out bench_frames.csv]\n";
+        return 1;
+    }
+#if GLFW_VERSION_MAJOR * 100 + GLFW_VERSION_MINOR >= 304
+    if(benchmark.config.headless) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+    if(!glfwInit()) return 1;
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#if GLFW_VERSION_MAJOR * 100 + GLFW_VERSION_MINOR >= 304
+    if(benchmark.config.headless) glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+    benchmark.Start(benchmark.config.width, benchmark.config.height, "Rogue-like-game benchmark");
+    return benchmark.passed ? 0 : 1;
+}
@@ -2,6 +2,18 @@
 #define GAME_H
 
 #include "custom-game-engine/headers/includes.h"
+#include "memory.h"
+#include "input.h"
+#ifdef INSTANCED_SPRITES
+#include "instanced.h"
+#endif
+#include <condition_variable>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <tuple>
+#include <thread>
 
 constexpr Rect<float> mapBound = {{90.0f, 160.0f}, {830.0f, 490.0f}};
 
@@ -19,6 +31,100 @@ enum class PowerupType
     None
 };
 
+enum class Stat : uint8_t
+{
+    Speed,
+    MaxHealth,
+    CoinsPerKill,
+    DamageTaken,
+    HealthFloor,
+    Count
+};
+
+constexpr std::size_t statCount = static_cast<std::size_t>(Stat::Count);
+
+enum class ModifierSource : uint8_t
+{
+    Market,
+    Powerup
+};
+
+struct Modifier
+{
+    Stat stat;
+    float add = 0.0f;
+    float mul = 1.0f;
+    float duration = -1.0f;
+    ModifierSource source = ModifierSource::Market;
+};
+
+struct StatBlock
+{
+    std::array<float, statCount> values = {};
+    inline float operator[](Stat stat) const
+    {
+        return values[static_cast<std::size_t>(stat)];
+    }
+    inline float& operator[](Stat stat)
+    {
+        return values[static_cast<std::size_t>(stat)];
+    }
+};
+
+struct ModifierStack
+{
+    StatBlock base;
+    std::vector<Modifier> modifiers;
+    inline ModifierStack()
+    {
+        base[Stat::DamageTaken] = 1.0f;
+    }
+    inline void Add(const Modifier& modifier)
+    {
+        modifiers.push_back(modifier);
+    }
+    inline void Clear(ModifierSource source)
+    {
+        modifiers.erase(std::remove_if(modifiers.begin(), modifiers.end(), 
+            [&](const Modifier& modifier){return modifier.source == source;}), modifiers.end());
+    }
+    inline void Update(float delta)
+    {
+        for(auto& modifier : modifiers)
+            if(modifier.duration > 0.0f) modifier.duration = std::max(modifier.duration - delta, 0.0f);
+        modifiers.erase(std::remove_if(modifiers.begin(), modifiers.end(), 
+            [](const Modifier& modifier){return modifier.duration == 0.0f;}), modifiers.end());
+    }
+    inline StatBlock Fold() const
+    {
+        StatBlock add, mul;
+        mul.values.fill(1.0f);
+        for(auto& modifier : modifiers)
+        {
+            add[modifier.stat] += modifier.add;
+            mul[modifier.stat] *= modifier.mul;
+        }
+        StatBlock stats;
+        for(std::size_t i = 0; i < statCount; i++)
+            stats.values[i] = (base.values[i] + add.values[i]) * mul.values[i];
+        return stats;
+    }
+};
+
+constexpr float powerupDuration = 10.0f;
+
+inline Modifier GetPowerupModifier(PowerupType type, float duration)
+{
+    switch(type)
+    {
+        case PowerupType::Speed: return {Stat::Speed, 0.0f, 2.0f, duration, ModifierSource::Powerup};
+        case PowerupType::Health: return {Stat::HealthFloor, 1.0f, 1.0f, duration, ModifierSource::Powerup};
+        case PowerupType::Money: return {Stat::CoinsPerKill, 0.0f, 3.0f, duration, ModifierSource::Powerup};
+        case PowerupType::Shield: return {Stat::DamageTaken, 0.0f, 0.0f, duration, ModifierSource::Powerup};
+        default: return {Stat::Speed, 0.0f, 1.0f, duration, ModifierSource::Powerup};
+    }
+}
+
 enum class CharacterState
 {
     Walking,
@@ -27,48 +133,250 @@ enum class CharacterState
     Dash
 };
 
+inline int RandomInt(std::minstd_rand& rng, int min, int max)
+{
+    return std::uniform_int_distribution<int>(min, max - 1)(rng);
+}
+
+inline vec2 RandomPoint(std::minstd_rand& rng, const Rect<float>& rc)
+{
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    return rc.pos + rc.size * vec2(dist(rng), dist(rng));
+}
+
 inline bool InBounds(const vec2& pos, const Rect<float>& rc)
 {
     return rc.Contains(pos);
 }
 
+inline bool Overlaps(const Rect<float>& a, const Rect<float>& b)
+{
+    return a.pos.x < b.pos.x + b.size.x && b.pos.x < a.pos.x + a.size.x &&
+        a.pos.y < b.pos.y + b.size.y && b.pos.y < a.pos.y + a.size.y;
+}
+
+inline Rect<float> CenteredBounds(const vec2& center, const vec2& halfExtent)
+{
+    return {center - halfExtent, halfExtent * 2.0f};
+}
+
+inline Rect<float> Union(const Rect<float>& a, const Rect<float>& b)
+{
+    const vec2 min = {std::min(a.pos.x, b.pos.x), std::min(a.pos.y, b.pos.y)};
+    const vec2 max = {std::max(a.pos.x + a.size.x, b.pos.x + b.size.x), std::max(a.pos.y + a.size.y, b.pos.y + b.size.y)};
+    return {min, max - min};
+}
+
+template <typename W> inline auto MeasureText(W* window, const std::string& text, float scale, int) -> decltype(vec2(window->GetTextSize(text, scale)))
+{
+    return vec2(window->GetTextSize(text, scale));
+}
+
+template <typename W> inline vec2 MeasureText(W*, const std::string& text, float scale, long)
+{
+    std::size_t columns = 0, lines = 1, column = 0;
+    for(char c : text)
+    {
+        if(c == '\n')
+        {
+            lines++;
+            column = 0;
+        }
+        else columns = std::max(columns, ++column);
+    }
+    return vec2(columns, lines) * 8.0f * scale;
+}
+
+inline Rect<float> TextBounds(Window* window, float x, float y, const std::string& text, float scale, float originX = 0.0f)
+{
+    const vec2 size = MeasureText(window, text, scale, 0);
+    return {{x - size.x * originX, y}, size};
+}
+
+template <typename A> inline void AddFrame(A& animator, const std::string& path, vec2& frameSize)
+{
+    animator.AddFrame(path);
+    const Sprite frame(path);
+    frameSize = {std::max(frameSize.x, static_cast<float>(frame.width)), std::max(frameSize.y, static_cast<float>(frame.height))};
+}
+
+struct LayerCompositor
+{
+    std::vector<Rect<float>> clearedRects;
+    std::vector<Rect<float>> dirtyRects;
+    bool fullRedraw = true;
+    inline void Invalidate()
+    {
+        fullRedraw = true;
+    }
+    inline void Begin(Window* window)
+    {
+        clearedRects.swap(dirtyRects);
+        dirtyRects.clear();
+        if(fullRedraw)
+        {
+            window->Clear(Colors::Transparent);
+            return;
+        }
+        for(auto& rc : clearedRects) ClearRect(window, rc);
+    }
+    inline void ClearRect(Window* window, const Rect<float>& rc)
+    {
+        const float width = window->GetWidth(), height = window->GetHeight();
+        const float x0 = std::clamp(rc.pos.x, 0.0f, width), y0 = std::clamp(rc.pos.y, 0.0f, height);
+        const float x1 = std::clamp(rc.pos.x + rc.size.x, 0.0f, width), y1 = std::clamp(rc.pos.y + rc.size.y, 0.0f, height);
+        window->SetPixelMode(PixelMode::Normal);
+        if(x1 > x0 && y1 > y0) window->DrawRect(x0, y0, x1 - x0, y1 - y0, Colors::Transparent);
+    }
+    inline void MarkDynamic(const Rect<float>& rc)
+    {
+        dirtyRects.push_back(rc);
+    }
+    inline bool NeedsStaticRedraw(const Rect<float>& rc, bool changed)
+    {
+        if(fullRedraw || changed) return true;
+        for(auto& cleared : clearedRects)
+            if(Overlaps(cleared, rc)) return true;
+        return false;
+    }
+    inline bool BeginStatic(Window* window, const Rect<float>& rc, bool changed)
+    {
+        if(!NeedsStaticRedraw(rc, changed)) return false;
+        if(!fullRedraw) ClearRect(window, rc);
+        return true;
+    }
+    inline void End()
+    {
+        fullRedraw = false;
+    }
+};
+
+enum class DrawLayer : uint8_t
+{
+    Entities,
+    Projectiles,
+    Overlay
+};
+
+struct DrawItem
+{
+    DrawLayer layer;
+    const void* texture;
+    float y;
+    Rect<float> bounds;
+    void* object;
+    void (*draw)(void*, Window*, LayerCompositor&);
+};
+
+struct DrawQueue
+{
+    std::vector<DrawItem> items;
+    std::vector<uint32_t> order;
+    std::vector<uint8_t> emitted;
+    std::size_t lookahead = 16;
+    Rect<float> view;
+    int visible = 0, culled = 0, textureSwitches = 0;
+    inline void Begin(Window* window)
+    {
+        view = {{0.0f, 0.0f}, {static_cast<float>(window->GetWidth()), static_cast<float>(window->GetHeight())}};
+        items.clear();
+        culled = 0;
+    }
+    template <typename T, void (T::*Draw)(Window*, LayerCompositor&)> inline void Push(DrawLayer layer, const void* texture, float y, const Rect<float>& bounds, T& object)
+    {
+        if(!Overlaps(bounds, view))
+        {
+            culled++;
+            return;
+        }
+        items.push_back({layer, texture, y, bounds, &object, [](void* object, Window* window, LayerCompositor& compositor)
+        {
+            (static_cast<T*>(object)->*Draw)(window, compositor);
+        }});
+    }
+    inline void Sort()
+    {
+        std::stable_sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b)
+            {return a.layer != b.layer ? a.layer < b.layer : a.y < b.y;});
+        order.clear();
+        emitted.assign(items.size(), 0);
+        for(std::size_t i = 0; i < items.size(); i++)
+        {
+            if(emitted[i]) continue;
+            emitted[i] = 1;
+            order.push_back(i);
+            const std::size_t end = std::min(items.size(), i + 1 + lookahead);
+            for(std::size_t j = i + 1; j < end && items[j].layer == items[i].layer; j++)
+            {
+                if(emitted[j] || items[j].texture != items[i].texture) continue;
+                bool blocked = false;
+                for(std::size_t k = i + 1; k < j && !blocked; k++)
+                    blocked = !emitted[k] && Overlaps(items[k].bounds, items[j].bounds);
+                if(blocked) continue;
+                emitted[j] = 1;
+                order.push_back(j);
+            }
+        }
+    }
+    inline void Submit(Window* window, LayerCompositor& compositor)
+    {
+        Sort();
+        visible = items.size();
+        textureSwitches = 0;
+        const void* texture = nullptr;
+        for(auto index : order)
+        {
+            DrawItem& item = items[index];
+            if(item.texture != texture) textureSwitches++;
+            texture = item.texture;
+            item.draw(item.object, window, compositor);
+        }
+        items.clear();
+    }
+};
+
 struct Character
 {
-    PowerupType currPowerup = PowerupType::None;
-    float speed = 150.0f;
-    int health, maxHealth;
-    int coins, coinMultiplier;
+    ModifierStack modifiers;
+    StatBlock stats;
+    int health;
+    int coins;
     vec2 pos;
     bool facesRight = true;
+    float size = 3.5f;
+    vec2 halfExtent;
     StateMachine<Sprite, CharacterState> stateMachine;
-    EntityDef<Sprite, CharacterState>* def;
+    TrackedPtr<EntityDef<Sprite, CharacterState>> def;
     Character()
     {
-        def = new EntityDef<Sprite, CharacterState>();
+        MemoryScope scope(MemoryTag::Animation);
+        def = MakeTracked<EntityDef<Sprite, CharacterState>>(MemoryTag::Animation);
+        vec2 frameSize;
         
-        (*def)[CharacterState::Walking].AddFrame("assets\\character\\move\\frame-1.png");
-        (*def)[CharacterState::Walking].AddFrame("assets\\character\\move\\frame-2.png");
-        (*def)[CharacterState::Walking].AddFrame("assets\\character\\move\\frame-3.png");
-        (*def)[CharacterState::Walking].AddFrame("assets\\character\\move\\frame-4.png");
-        (*def)[CharacterState::Idle].AddFrame("assets\\character\\idle\\frame-1.png");
-        (*def)[CharacterState::Idle].AddFrame("assets\\character\\idle\\frame-2.png");
-        (*def)[CharacterState::Idle].AddFrame("assets\\character\\idle\\frame-3.png");
-        (*def)[CharacterState::Idle].AddFrame("assets\\character\\idle\\frame-4.png");
-        (*def)[CharacterState::Dash].AddFrame("assets\\character\\dash\\frame-1.png");
-        (*def)[CharacterState::Dash].AddFrame("assets\\character\\dash\\frame-2.png");
-        (*def)[CharacterState::Dash].AddFrame("assets\\character\\dash\\frame-3.png");
-        (*def)[CharacterState::Dash].AddFrame("assets\\character\\dash\\frame-4.png");
-        (*def)[CharacterState::Dash].AddFrame("assets\\character\\dash\\frame-5.png");
-        (*def)[CharacterState::Dash].AddFrame("assets\\character\\dash\\frame-6.png");
-        (*def)[CharacterState::Dash].AddFrame("assets\\character\\dash\\frame-7.png");
-        (*def)[CharacterState::Dash].AddFrame("assets\\character\\dash\\frame-8.png");
-        (*def)[CharacterState::Dash].AddFrame("assets\\character\\dash\\frame-9.png");
-        (*def)[CharacterState::Attack].AddFrame("assets\\character\\attack\\frame-1.png");
-        (*def)[CharacterState::Attack].AddFrame("assets\\character\\attack\\frame-2.png");
-        (*def)[CharacterState::Attack].AddFrame("assets\\character\\attack\\frame-3.png");
-        (*def)[CharacterState::Attack].AddFrame("assets\\character\\attack\\frame-4.png");
+        AddFrame((*def)[CharacterState::Walking], "assets\\character\\move\\frame-1.png", frameSize);
+        AddFrame((*def)[CharacterState::Walking], "assets\\character\\move\\frame-2.png", frameSize);
+        AddFrame((*def)[CharacterState::Walking], "assets\\character\\move\\frame-3.png", frameSize);
+        AddFrame((*def)[CharacterState::Walking], "assets\\character\\move\\frame-4.png", frameSize);
+        AddFrame((*def)[CharacterState::Idle], "assets\\character\\idle\\frame-1.png", frameSize);
+        AddFrame((*def)[CharacterState::Idle], "assets\\character\\idle\\frame-2.png", frameSize);
+        AddFrame((*def)[CharacterState::Idle], "assets\\character\\idle\\frame-3.png", frameSize);
+        AddFrame((*def)[CharacterState::Idle], "assets\\character\\idle\\frame-4.png", frameSize);
+        AddFrame((*def)[CharacterState::Dash], "assets\\character\\dash\\frame-1.png", frameSize);
+        AddFrame((*def)[CharacterState::Dash], "assets\\character\\dash\\frame-2.png", frameSize);
+        AddFrame((*def)[CharacterState::Dash], "assets\\character\\dash\\frame-3.png", frameSize);
+        AddFrame((*def)[CharacterState::Dash], "assets\\character\\dash\\frame-4.png", frameSize);
+        AddFrame((*def)[CharacterState::Dash], "assets\\character\\dash\\frame-5.png", frameSize);
+        AddFrame((*def)[CharacterState::Dash], "assets\\character\\dash\\frame-6.png", frameSize);
+        AddFrame((*def)[CharacterState::Dash], "assets\\character\\dash\\frame-7.png", frameSize);
+        AddFrame((*def)[CharacterState::Dash], "assets\\character\\dash\\frame-8.png", frameSize);
+        AddFrame((*def)[CharacterState::Dash], "assets\\character\\dash\\frame-9.png", frameSize);
+        AddFrame((*def)[CharacterState::Attack], "assets\\character\\attack\\frame-1.png", frameSize);
+        AddFrame((*def)[CharacterState::Attack], "assets\\character\\attack\\frame-2.png", frameSize);
+        AddFrame((*def)[CharacterState::Attack], "assets\\character\\attack\\frame-3.png", frameSize);
+        AddFrame((*def)[CharacterState::Attack], "assets\\character\\attack\\frame-4.png", frameSize);
         
-        stateMachine.SetDefinition(def);
+        halfExtent = frameSize * size * 0.5f;
+        stateMachine.SetDefinition(def.get());
         stateMachine.DefineState(CharacterState::Walking, 0.2f, Style::Repeat);
         stateMachine.DefineState(CharacterState::Idle, 0.2f, Style::Repeat);
         stateMachine.DefineState(CharacterState::Attack, 0.1f, Style::PlayOnce);
@@ -78,19 +386,17 @@ struct Character
 
         coins = 0;
     }
-    inline void Movement(Window* window, float speed)
+    inline void Movement(const InputState& input, float dt, float speed)
     {
         if(!stateMachine.IsCurrentState(CharacterState::Walking)) return;
-        const float dt = window->GetDeltaTime();
-        if(currPowerup == PowerupType::Speed) speed *= 2.0f;
-        if(window->GetKey(GLFW_KEY_W) == Key::Held) pos.y -= speed * dt;
-        if(window->GetKey(GLFW_KEY_S) == Key::Held) pos.y += speed * dt;
-        if(window->GetKey(GLFW_KEY_A) == Key::Held) 
+        if(input.IsHeld(GLFW_KEY_W)) pos.y -= speed * dt;
+        if(input.IsHeld(GLFW_KEY_S)) pos.y += speed * dt;
+        if(input.IsHeld(GLFW_KEY_A)) 
         {
             pos.x -= speed * dt;
             if(facesRight) facesRight = !facesRight;
         }
-        if(window->GetKey(GLFW_KEY_D) == Key::Held) 
+        if(input.IsHeld(GLFW_KEY_D)) 
         {
             pos.x += speed * dt;
             if(!facesRight) facesRight = !facesRight;
@@ -100,34 +406,52 @@ struct Character
         if(pos.y < mapBound.pos.y) pos.y += speed * dt;
         if(pos.y > mapBound.pos.y + mapBound.size.y) pos.y -= speed * dt;
     }
-    inline void Dash(Window* window)
+    inline void Dash(float dt)
     {
         if(!stateMachine.IsCurrentState(CharacterState::Dash)) return;
-        float dx = 600.0f * window->GetDeltaTime() * (!facesRight ? -1 : 1);
+        float dx = 600.0f * dt * (!facesRight ? -1 : 1);
         if((pos.x + dx) > mapBound.pos.x && (pos.x + dx) < mapBound.pos.x + mapBound.size.x) pos.x += dx;
     }
-    inline void UpdateStates(Window* window)
+    inline void UpdateStates(const InputState& input)
     {
         if((stateMachine.IsCurrentState(CharacterState::Dash) || stateMachine.IsCurrentState(CharacterState::Attack))
             && !stateMachine.HasCurrentAnimationFinishedPlaying()) return;
-        if(window->GetKey(GLFW_KEY_LEFT_SHIFT) == Key::Pressed) stateMachine.SetState(CharacterState::Dash);
-        else if(window->GetMouseButton(GLFW_MOUSE_BUTTON_1) == Key::Pressed) stateMachine.SetState(CharacterState::Attack);
-        else stateMachine.SetState((window->GetKey(GLFW_KEY_A) == Key::Held || window->GetKey(GLFW_KEY_W) == Key::Held || 
-        window->GetKey(GLFW_KEY_S) == Key::Held || window->GetKey(GLFW_KEY_D) == Key::Held) ? CharacterState::Walking : CharacterState::Idle);
+        if(input.IsPressed(GLFW_KEY_LEFT_SHIFT)) stateMachine.SetState(CharacterState::Dash);
+        else if(input.IsButtonPressed(GLFW_MOUSE_BUTTON_1)) stateMachine.SetState(CharacterState::Attack);
+        else stateMachine.SetState((input.IsHeld(GLFW_KEY_A) || input.IsHeld(GLFW_KEY_W) || 
+        input.IsHeld(GLFW_KEY_S) || input.IsHeld(GLFW_KEY_D)) ? CharacterState::Walking : CharacterState::Idle);
+    }
+    inline void Update(const InputState& input, float delta)
+    {
+        modifiers.Update(delta);
+        stats = modifiers.Fold();
+        health = std::max(health, static_cast<int>(std::min(stats[Stat::HealthFloor], 1.0f) * stats[Stat::MaxHealth]));
+        UpdateStates(input);
+        Movement(input, delta, stats[Stat::Speed]);
+        Dash(delta);
+        stateMachine.Update(delta);
+    }
+    inline void DrawBody(Window* window, LayerCompositor& compositor)
+    {
+#ifdef INSTANCED_SPRITES
+        if(!DrawAnimation(window, stateMachine, def.get(), pos, size, facesRight)) return;
+#else
+        stateMachine.Draw(window, pos, size, 0.0f, facesRight ? 0 : Horizontal);
+#endif
+        compositor.MarkDynamic(CenteredBounds(pos, halfExtent));
     }
-    inline void Update(Window* window)
+    inline void Enqueue(DrawQueue& queue)
     {
-        if(currPowerup == PowerupType::Health) health = maxHealth;
-        UpdateStates(window);
-        Movement(window, speed);
-        Dash(window);
-        stateMachine.Update(window->GetDeltaTime());
+        queue.Push<Character, &Character::DrawBody>(DrawLayer::Entities, def.get(), pos.y, CenteredBounds(pos, halfExtent), *this);
     }
-    inline void Draw(Window* window)
+    inline void DrawHud(Window* window, LayerCompositor& compositor)
     {
-        stateMachine.Draw(window, pos, 3.5f, 0.0f, facesRight ? 0 : Horizontal);
-        window->DrawText(32, 35, "HEALTH:" + std::to_string(health), 2.0f, Colors::White);
-        window->DrawText(32, 63, "COINS:" + std::to_string(coins), 2.0f, Colors::White);
+        const std::string healthText = "HEALTH:" + std::to_string(health);
+        const std::string coinsText = "COINS:" + std::to_string(coins);
+        window->DrawText(32, 35, healthText, 2.0f, Colors::White);
+        window->DrawText(32, 63, coinsText, 2.0f, Colors::White);
+        compositor.MarkDynamic(TextBounds(window, 32, 35, healthText, 2.0f));
+        compositor.MarkDynamic(TextBounds(window, 32, 63, coinsText, 2.0f));
     }
     inline void Serialize(std::reference_wrapper<DataNode> datanode)
     {
@@ -140,12 +464,12 @@ struct Character
     inline void SetDefault()
     {
         pos = 200.0f;
-        health = maxHealth;
+        modifiers.Clear(ModifierSource::Powerup);
+        stats = modifiers.Fold();
+        health = stats[Stat::MaxHealth];
         stateMachine.SetState(CharacterState::Idle);
         facesRight = true;
-        currPowerup = PowerupType::None;
     }
-    ~Character() {}
 };
 
 enum class EnemyState
@@ -157,10 +481,20 @@ enum class EnemyState
     Spawn
 };
 
+enum class EnemyType : uint8_t
+{
+    Ghost,
+    Ranged,
+    Count
+};
+
+constexpr std::size_t enemyTypeCount = static_cast<std::size_t>(EnemyType::Count);
+
 struct EnemyDef
 {
     EntityDef<Sprite, EnemyState> enemyDef;
     float size, healthBarOffset;
+    vec2 halfExtent;
     Sprite sprEnergyBall;
 };
 
@@ -168,41 +502,43 @@ struct GhostDef : EnemyDef
 {
     GhostDef()
     {
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\enemy\\dead\\frame-10.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\enemy\\dead\\frame-9.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\enemy\\dead\\frame-8.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\enemy\\dead\\frame-7.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\enemy\\dead\\frame-6.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\enemy\\dead\\frame-5.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\enemy\\dead\\frame-4.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\enemy\\dead\\frame-3.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\enemy\\dead\\frame-2.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\enemy\\dead\\frame-1.png");
-        enemyDef[EnemyState::Attack].AddFrame("assets\\enemy\\attack\\frame-1.png");
-        enemyDef[EnemyState::Attack].AddFrame("assets\\enemy\\attack\\frame-2.png");
-        enemyDef[EnemyState::Attack].AddFrame("assets\\enemy\\attack\\frame-3.png");
-        enemyDef[EnemyState::Attack].AddFrame("assets\\enemy\\attack\\frame-4.png");
-        enemyDef[EnemyState::Attack].AddFrame("assets\\enemy\\attack\\frame-5.png");
-        enemyDef[EnemyState::Attack].AddFrame("assets\\enemy\\attack\\frame-6.png");
-        enemyDef[EnemyState::Attack].AddFrame("assets\\enemy\\attack\\frame-7.png");
-        enemyDef[EnemyState::Attack].AddFrame("assets\\enemy\\attack\\frame-8.png");
-        enemyDef[EnemyState::Attack].AddFrame("assets\\enemy\\attack\\frame-9.png");
-        enemyDef[EnemyState::Idle].AddFrame("assets\\enemy\\idle\\frame-1.png");
-        enemyDef[EnemyState::Idle].AddFrame("assets\\enemy\\idle\\frame-2.png");
-        enemyDef[EnemyState::Move].AddFrame("assets\\enemy\\move\\frame-1.png");
-        enemyDef[EnemyState::Move].AddFrame("assets\\enemy\\move\\frame-2.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\enemy\\dead\\frame-1.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\enemy\\dead\\frame-2.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\enemy\\dead\\frame-3.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\enemy\\dead\\frame-4.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\enemy\\dead\\frame-5.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\enemy\\dead\\frame-6.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\enemy\\dead\\frame-7.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\enemy\\dead\\frame-8.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\enemy\\dead\\frame-9.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\enemy\\dead\\frame-10.png");
+        vec2 frameSize;
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\enemy\\dead\\frame-10.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\enemy\\dead\\frame-9.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\enemy\\dead\\frame-8.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\enemy\\dead\\frame-7.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\enemy\\dead\\frame-6.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\enemy\\dead\\frame-5.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\enemy\\dead\\frame-4.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\enemy\\dead\\frame-3.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\enemy\\dead\\frame-2.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\enemy\\dead\\frame-1.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Attack], "assets\\enemy\\attack\\frame-1.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Attack], "assets\\enemy\\attack\\frame-2.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Attack], "assets\\enemy\\attack\\frame-3.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Attack], "assets\\enemy\\attack\\frame-4.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Attack], "assets\\enemy\\attack\\frame-5.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Attack], "assets\\enemy\\attack\\frame-6.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Attack], "assets\\enemy\\attack\\frame-7.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Attack], "assets\\enemy\\attack\\frame-8.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Attack], "assets\\enemy\\attack\\frame-9.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Idle], "assets\\enemy\\idle\\frame-1.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Idle], "assets\\enemy\\idle\\frame-2.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Move], "assets\\enemy\\move\\frame-1.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Move], "assets\\enemy\\move\\frame-2.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\enemy\\dead\\frame-1.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\enemy\\dead\\frame-2.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\enemy\\dead\\frame-3.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\enemy\\dead\\frame-4.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\enemy\\dead\\frame-5.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\enemy\\dead\\frame-6.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\enemy\\dead\\frame-7.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\enemy\\dead\\frame-8.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\enemy\\dead\\frame-9.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\enemy\\dead\\frame-10.png", frameSize);
         healthBarOffset = 100.0f;
         size = 4.5f;
+        halfExtent = frameSize * size * 0.5f;
     }
 };
 
@@ -210,35 +546,31 @@ struct RangedDef : EnemyDef
 {
     RangedDef()
     {
-        enemyDef[EnemyState::Attack].AddFrame("assets\\ranged-enemy\\attack\\frame-0.png");
-        enemyDef[EnemyState::Attack].AddFrame("assets\\ranged-enemy\\attack\\frame-1.png");
-        enemyDef[EnemyState::Attack].AddFrame("assets\\ranged-enemy\\attack\\frame-2.png");
-        enemyDef[EnemyState::Idle].AddFrame("assets\\ranged-enemy\\idle\\frame-1.png");
-        enemyDef[EnemyState::Idle].AddFrame("assets\\ranged-enemy\\idle\\frame-2.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\ranged-enemy\\dead\\frame-0.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\ranged-enemy\\dead\\frame-1.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\ranged-enemy\\dead\\frame-2.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\ranged-enemy\\dead\\frame-3.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\ranged-enemy\\dead\\frame-4.png");
-        enemyDef[EnemyState::Dead].AddFrame("assets\\ranged-enemy\\dead\\frame-5.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\ranged-enemy\\spawn\\frame-0.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\ranged-enemy\\spawn\\frame-1.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\ranged-enemy\\spawn\\frame-2.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\ranged-enemy\\spawn\\frame-3.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\ranged-enemy\\spawn\\frame-4.png");
-        enemyDef[EnemyState::Spawn].AddFrame("assets\\ranged-enemy\\spawn\\frame-5.png");
+        vec2 frameSize;
+        AddFrame(enemyDef[EnemyState::Attack], "assets\\ranged-enemy\\attack\\frame-0.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Attack], "assets\\ranged-enemy\\attack\\frame-1.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Attack], "assets\\ranged-enemy\\attack\\frame-2.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Idle], "assets\\ranged-enemy\\idle\\frame-1.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Idle], "assets\\ranged-enemy\\idle\\frame-2.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\ranged-enemy\\dead\\frame-0.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\ranged-enemy\\dead\\frame-1.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\ranged-enemy\\dead\\frame-2.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\ranged-enemy\\dead\\frame-3.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\ranged-enemy\\dead\\frame-4.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Dead], "assets\\ranged-enemy\\dead\\frame-5.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\ranged-enemy\\spawn\\frame-0.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\ranged-enemy\\spawn\\frame-1.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\ranged-enemy\\spawn\\frame-2.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\ranged-enemy\\spawn\\frame-3.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\ranged-enemy\\spawn\\frame-4.png", frameSize);
+        AddFrame(enemyDef[EnemyState::Spawn], "assets\\ranged-enemy\\spawn\\frame-5.png", frameSize);
         sprEnergyBall = Sprite("assets\\ranged-enemy\\energy-ball.png");
         healthBarOffset = 80.0f;
         size = 3.5f;
+        halfExtent = frameSize * size * 0.5f;
     }
 };
 
-enum class EnemyType : uint8_t
-{
-    Ghost,
-    Ranged
-};
-
 inline void DrawHealth(float x, float y, Window* window, float width, float height, float health, float min = 0.0f, float max = 100.0f)
 {
     float finalWidth = width * health / (max - min);
@@ -246,27 +578,66 @@ inline void DrawHealth(float x, float y, Window* window, float width, float heig
     window->DrawRect(x + finalWidth - width * 0.5f, y - height * 0.5f, width - finalWidth, height, Color(0, 0, 0, 255));
 }
 
-std::unordered_map<EnemyType, EnemyDef*> defMap
+inline void DrawMemoryStats(Window* window, float x, float y)
 {
-    {EnemyType::Ghost, new GhostDef()},
-    {EnemyType::Ranged, new RangedDef()}
-};
+    for(std::size_t i = 0; i < memoryTagCount; i++)
+    {
+        const MemoryTag tag = static_cast<MemoryTag>(i);
+        std::string text = GetMemoryTagName(tag);
+        for(auto& c : text) c = std::toupper(c);
+        text += ":" + std::to_string(memoryTracker.GetLiveBytes(tag) / 1024) + "KB ";
+        text += std::to_string(static_cast<int>(memoryTracker.GetAllocRate(tag) / 1024.0f)) + "KB/S";
+        window->DrawText(x, y + i * 20.0f, text, 1.5f, memoryTracker.ExceedsCeiling(tag) ? Colors::DarkRed : Colors::White);
+    }
+}
+
+inline void DrawQueueStats(Window* window, float x, float y, const DrawQueue& queue)
+{
+    std::string text = "DRAW:" + std::to_string(queue.visible) + " VISIBLE ";
+    text += std::to_string(queue.culled) + " CULLED ";
+    text += std::to_string(queue.textureSwitches) + " SWITCHES";
+    window->DrawText(x, y, text, 1.5f, Colors::White);
+}
+
+inline EnemyDef& GetEnemyDef(EnemyType type);
 
 struct EnemyBase
 {
     StateMachine<Sprite, EnemyState> stateMachine;
     bool facesRight = true;
+    bool remove = false;
     float health = 100.0f;
     vec2 pos = 0.0f;
-    EnemyType type;
-    virtual void Update(Character& character, float delta) = 0;
-    virtual void Draw(Window* window) = 0;
-    virtual void GiveDamage(Character& character, float delta) = 0;
-    virtual void SetSpawnData(const vec2& pos) = 0;
-    inline void DrawSelf(Window* window)
+    inline Rect<float> GetHealthBarBounds(const EnemyDef& def) const
+    {
+        return {{pos.x - 25.0f, pos.y - def.healthBarOffset - 5.0f}, {50.0f, 10.0f}};
+    }
+    template <typename T> inline void DrawBody(Window* window, LayerCompositor& compositor)
     {
-        stateMachine.Draw(window, pos, defMap.at(type)->size, 0.0f, facesRight ? 0 : Flip::Horizontal);
-        DrawHealth(pos.x, pos.y - defMap.at(type)->healthBarOffset, window, 50.0f, 10.0f, health);
+        const EnemyDef& def = GetEnemyDef(T::type);
+#ifdef INSTANCED_SPRITES
+        if(!DrawAnimation(window, stateMachine, &def.enemyDef, pos, def.size, facesRight)) return;
+#else
+        stateMachine.Draw(window, pos, def.size, 0.0f, facesRight ? 0 : Flip::Horizontal);
+#endif
+        compositor.MarkDynamic(CenteredBounds(pos, def.halfExtent));
+    }
+    template <typename T> inline void DrawHealthBar(Window* window, LayerCompositor& compositor)
+    {
+        const EnemyDef& def = GetEnemyDef(T::type);
+        DrawHealth(pos.x, pos.y - def.healthBarOffset, window, 50.0f, 10.0f, health);
+        compositor.MarkDynamic(GetHealthBarBounds(def));
+    }
+    template <typename T> inline void EnqueueSelf(DrawQueue& queue)
+    {
+        const EnemyDef& def = GetEnemyDef(T::type);
+        queue.Push<EnemyBase, &EnemyBase::DrawBody<T>>(DrawLayer::Entities, &def.enemyDef, pos.y, CenteredBounds(pos, def.halfExtent), *this);
+        queue.Push<EnemyBase, &EnemyBase::DrawHealthBar<T>>(DrawLayer::Overlay, nullptr, pos.y, GetHealthBarBounds(def), *this);
+    }
+    inline void UpdateRemoval(Character& character)
+    {
+        if(stateMachine.IsCurrentState(EnemyState::Dead)) remove = stateMachine.HasCurrentAnimationFinishedPlaying();
+        if(remove) character.coins += static_cast<int>(character.stats[Stat::CoinsPerKill]);
     }
     inline void UpdateSelf(Character& character, float delta)
     {
@@ -290,15 +661,16 @@ struct EnemyBase
 
 struct Ghost : EnemyBase
 {
+    static constexpr EnemyType type = EnemyType::Ghost;
+    using Def = GhostDef;
     Ghost()
     {
-        type = EnemyType::Ghost;
         stateMachine.DefineState(EnemyState::Spawn, 0.2f, Style::PlayOnce);
         stateMachine.DefineState(EnemyState::Idle, 0.2f, Style::Repeat);
         stateMachine.DefineState(EnemyState::Attack, 0.2f, Style::PlayOnce);
         stateMachine.DefineState(EnemyState::Move, 0.2f, Style::Repeat);
         stateMachine.DefineState(EnemyState::Dead, 0.2f, Style::PlayOnce);
-        stateMachine.SetDefinition(&defMap.at(type)->enemyDef);
+        stateMachine.SetDefinition(&GetEnemyDef(type).enemyDef);
         stateMachine.SetState(EnemyState::Spawn);
     }
     inline void UpdateStates(Character& character)
@@ -309,7 +681,7 @@ struct Ghost : EnemyBase
         if(dist <= 100.0f) stateMachine.SetState(EnemyState::Attack);
         else stateMachine.SetState((!InBounds(pos, mapBound) || dist < 1000.0f) ? EnemyState::Move : EnemyState::Idle);
     }
-    inline void Update(Character& character, float delta) override
+    inline void Update(Character& character, float delta)
     {
         UpdateStates(character);
         if(stateMachine.IsCurrentState(EnemyState::Move)) Movement(character, delta);
@@ -323,18 +695,19 @@ struct Ghost : EnemyBase
         pos.x += std::cos(angle) * speed * delta;
         pos.y += std::sin(angle) * speed * delta;
     }
-    inline void GiveDamage(Character& character, float delta) override
+    inline void GiveDamage(Character& character, float delta)
     {
-        if(health <= 0.0f && character.currPowerup == PowerupType::Shield) return;
-        if(GetDistance(character) < 100.0f &&  stateMachine.IsCurrentState(EnemyState::Attack)) character.health -= delta;
+        if(health <= 0.0f) return;
+        if(GetDistance(character) < 100.0f &&  stateMachine.IsCurrentState(EnemyState::Attack)) 
+            character.health -= delta * character.stats[Stat::DamageTaken];
     }
-    inline void SetSpawnData(const vec2& pos) override
+    inline void SetSpawnData(const vec2& pos)
     {
         this->pos = pos;
     }
-    inline void Draw(Window* window) override
+    inline void Enqueue(DrawQueue& queue)
     {
-        DrawSelf(window);
+        EnqueueSelf<Ghost>(queue);
     }
 };
 
@@ -353,15 +726,16 @@ struct EnergyBall
 
 struct Ranged : EnemyBase
 {
+    static constexpr EnemyType type = EnemyType::Ranged;
+    using Def = RangedDef;
     Ranged()
     {
-        type = EnemyType::Ranged;
         timeSinceLastAttack = 0.0f;
         stateMachine.DefineState(EnemyState::Idle, 0.2f, Style::Repeat);
         stateMachine.DefineState(EnemyState::Spawn, 0.2f, Style::PlayOnce);
         stateMachine.DefineState(EnemyState::Attack, 0.2f, Style::PlayOnce);
         stateMachine.DefineState(EnemyState::Dead, 0.2f, Style::PlayOnce);
-        stateMachine.SetDefinition(&defMap.at(type)->enemyDef);
+        stateMachine.SetDefinition(&GetEnemyDef(type).enemyDef);
         stateMachine.SetState(EnemyState::Spawn);
         ball.remove = true;
     }
@@ -371,7 +745,7 @@ struct Ranged : EnemyBase
             stateMachine.IsCurrentState(EnemyState::Spawn)) && !stateMachine.HasCurrentAnimationFinishedPlaying()) return;
         stateMachine.SetState(timeSinceLastAttack < 5.0f ? EnemyState::Idle : EnemyState::Attack);
     }
-    inline void Update(Character& character, float delta) override
+    inline void Update(Character& character, float delta)
     {
         timeSinceLastAttack += delta;
         UpdateStates();
@@ -388,25 +762,38 @@ struct Ranged : EnemyBase
         stateMachine.SetState(EnemyState::Idle);
         timeSinceLastAttack = 0.0f;
     }
-    inline void Draw(Window* window) override
+    inline void Enqueue(DrawQueue& queue)
     {
-        DrawSelf(window);
-        DrawEnergyBall(window);
+        EnqueueSelf<Ranged>(queue);
+        if(ball.remove) return;
+        const EnemyDef& def = GetEnemyDef(type);
+        queue.Push<Ranged, &Ranged::DrawEnergyBall>(DrawLayer::Projectiles, &def.sprEnergyBall, ball.pos.y, GetEnergyBallBounds(), *this);
     }
-    inline void GiveDamage(Character& character, float delta) override
+    inline void GiveDamage(Character& character, float delta)
     {
-        if(health <= 0.0f || character.currPowerup == PowerupType::Shield || ball.remove || Distance(ball.pos, character.pos) > 50.0f) return;
-        character.health -= delta * 10.0f;
+        if(health <= 0.0f || character.stats[Stat::DamageTaken] == 0.0f || ball.remove || Distance(ball.pos, character.pos) > 50.0f) return;
+        character.health -= delta * 10.0f * character.stats[Stat::DamageTaken];
         ball.remove = true;
     }
-    inline void SetSpawnData(const vec2& pos) override
+    inline void SetSpawnData(const vec2& pos)
     {
         this->pos = ball.pos = pos;
     }
-    inline void DrawEnergyBall(Window* window) 
+    inline Rect<float> GetEnergyBallBounds()
     {
-        if(!ball.remove) 
-            window->DrawSprite(ball.pos.x, ball.pos.y, defMap.at(type)->sprEnergyBall, 5.0f);
+        const Sprite& sprite = GetEnemyDef(type).sprEnergyBall;
+        return CenteredBounds(ball.pos, vec2(sprite.width, sprite.height) * 2.5f);
+    }
+    inline void DrawEnergyBall(Window* window, LayerCompositor& compositor) 
+    {
+        if(ball.remove) return;
+#ifdef INSTANCED_SPRITES
+        Sprite& sprite = GetEnemyDef(type).sprEnergyBall;
+        if(!DrawEntitySprite(window, sprite, &sprite, ball.pos, 5.0f)) return;
+#else
+        window->DrawSprite(ball.pos.x, ball.pos.y, GetEnemyDef(type).sprEnergyBall, 5.0f);
+#endif
+        compositor.MarkDynamic(GetEnergyBallBounds());
     }
     inline void UpdateEnergyBall(Character& character, float delta)
     {
@@ -418,31 +805,65 @@ private:
     float timeSinceLastAttack;
 };
 
-struct EnemyWrapper
+template <typename... Ts> constexpr bool CoversEnemyTypes()
 {
-    EnemyBase* enemyBasePtr;
-    bool remove = false;
-    void Update(Character& character, float delta)
+    std::array<bool, enemyTypeCount> registered = {};
+    for(EnemyType type : {Ts::type...})
+    {
+        const std::size_t index = static_cast<std::size_t>(type);
+        if(index >= enemyTypeCount || registered[index]) return false;
+        registered[index] = true;
+    }
+    return sizeof...(Ts) == enemyTypeCount;
+}
+
+template <typename... Ts> struct EnemyRegistry
+{
+    static_assert(CoversEnemyTypes<Ts...>(), "Every EnemyType needs exactly one registered enemy.");
+    std::tuple<std::vector<Ts>...> pools;
+    static inline std::array<EnemyDef, enemyTypeCount> MakeDefs()
+    {
+        MemoryScope scope(MemoryTag::Animation);
+        std::array<EnemyDef, enemyTypeCount> defs;
+        ((defs[static_cast<std::size_t>(Ts::type)] = typename Ts::Def()), ...);
+        return defs;
+    }
+    template <typename T> inline std::vector<T>& Get()
+    {
+        return std::get<std::vector<T>>(pools);
+    }
+    template <typename F> inline void Foreach(F&& func)
+    {
+        std::apply([&](auto&... pool){(func(pool), ...);}, pools);
+    }
+    inline void Spawn(EnemyType type, const vec2& pos)
+    {
+        MemoryScope scope(MemoryTag::Enemies);
+        ((Ts::type == type ? (Get<Ts>().emplace_back().SetSpawnData(pos), true) : false) || ...);
+    }
+    inline std::size_t Size()
+    {
+        std::size_t size = 0;
+        Foreach([&](auto& pool){size += pool.size();});
+        return size;
+    }
+    inline bool Empty()
     {
-        if(enemyBasePtr->stateMachine.IsCurrentState(EnemyState::Dead)) remove = enemyBasePtr->stateMachine.HasCurrentAnimationFinishedPlaying();
-        int coinInc = remove ? (character.currPowerup == PowerupType::Money ? 3 : 1) : 0;
-        character.coins += character.coinMultiplier * coinInc;
-        enemyBasePtr->Update(character, delta);
+        return Size() == 0;
     }
-    void Draw(Window* window)
+    inline void Clear()
     {
-        enemyBasePtr->Draw(window);
+        Foreach([](auto& pool){pool.clear();});
     }
 };
 
-inline void SpawnEnemy(std::vector<EnemyWrapper>& enemies, const EnemyType& enemyType, Window* window)
+using Enemies = EnemyRegistry<Ghost, Ranged>;
+
+std::array<EnemyDef, enemyTypeCount> enemyDefs = Enemies::MakeDefs();
+
+inline EnemyDef& GetEnemyDef(EnemyType type)
 {
-    switch(enemyType)
-    {
-        case EnemyType::Ghost: enemies.push_back({new Ghost()}); break;
-        case EnemyType::Ranged: enemies.push_back({new Ranged()}); break;
-    }
-    enemies.back().enemyBasePtr->SetSpawnData(RandomPoint(mapBound));
+    return enemyDefs[static_cast<std::size_t>(type)];
 }
 
 enum class SpawnSystemState
@@ -454,25 +875,24 @@ enum class SpawnSystemState
 struct WaveSystem
 {
     float timeSinceSpawn;
-    std::vector<EnemyWrapper> enemies;
+    Enemies enemies;
+    std::minstd_rand rng;
     SpawnSystemState spawnSysState;
     int currentWave, enemiesSpawned;
+    bool waveCompleted = false;
     inline void Reset()
     {
+        waveCompleted = false;
         timeSinceSpawn = 0.0f;
         currentWave = 1;
         enemiesSpawned = 0;
         spawnSysState = SpawnSystemState::Cooldown;
-        for(auto& e : enemies)
-        {
-            delete e.enemyBasePtr;
-            e.enemyBasePtr = nullptr;
-        }
-        enemies.clear();
+        enemies.Clear();
     }
-    inline void Update(Window* window, Character& character)
+    inline void Update(float delta, Character& character)
     {
-        timeSinceSpawn += window->GetDeltaTime();
+        timeSinceSpawn += delta;
+        waveCompleted = false;
 
         switch(spawnSysState)
         {
@@ -492,31 +912,42 @@ struct WaveSystem
                 {
                     if(enemiesSpawned < currentWave) 
                     {
-                        SpawnEnemy(enemies, (EnemyType)random(0, 2), window);
+                        enemies.Spawn((EnemyType)RandomInt(rng, 0, enemyTypeCount), RandomPoint(rng, mapBound));
                         timeSinceSpawn = 0.0f;
                         enemiesSpawned++;
                     }
                 }
-                if(enemies.empty() && enemiesSpawned == currentWave)
+                if(enemies.Empty() && enemiesSpawned == currentWave)
                 {
                     timeSinceSpawn = 0.0f;
                     enemiesSpawned = 0;
                     spawnSysState = SpawnSystemState::Cooldown;
+                    waveCompleted = true;
                 }
             }
             break;
         }
 
-        for(auto& enemy : enemies) enemy.Update(character, window->GetDeltaTime());
-
-        enemies.erase(std::remove_if(enemies.begin(), enemies.end(), [](EnemyWrapper& wrapper){return wrapper.remove;}), enemies.end());
+        enemies.Foreach([&](auto& pool)
+        {
+            for(auto& enemy : pool)
+            {
+                enemy.UpdateRemoval(character);
+                enemy.Update(character, delta);
+            }
+            pool.erase(std::remove_if(pool.begin(), pool.end(), [](auto& enemy){return enemy.remove;}), pool.end());
+        });
+    }
+    inline void Enqueue(DrawQueue& queue)
+    {
+        enemies.Foreach([&](auto& pool){for(auto& enemy : pool) enemy.Enqueue(queue);});
     }
-    inline void Draw(Window* window)
+    inline void DrawHud(Window* window, LayerCompositor& compositor)
     {
-        window->DrawText(window->GetWidth() * 0.5f, 30, "WAVE " + std::to_string(currentWave), 3.0f,
+        const std::string waveText = "WAVE " + std::to_string(currentWave);
+        window->DrawText(window->GetWidth() * 0.5f, 30, waveText, 3.0f,
             (spawnSysState == SpawnSystemState::Cooldown) ? Colors::White : Colors::DarkRed, {0.5f, 0.0f});
-    
-        for(auto& enemy : enemies) enemy.Draw(window);
+        compositor.MarkDynamic(TextBounds(window, window->GetWidth() * 0.5f, 30, waveText, 3.0f, 0.5f));
     }
 };
 
@@ -525,6 +956,9 @@ struct Chest
     std::unordered_map<PowerupType, Sprite> powerups;
     vec2 pos = {900.0f, 170.0f};
     Animator<Sprite> animator;
+    vec2 frameSize;
+    PowerupType currPowerup = PowerupType::None;
+    std::minstd_rand rng;
     float elapsedTime;
     enum class ChestState
     {
@@ -534,9 +968,10 @@ struct Chest
     } chestState= ChestState::Closed;
     inline Chest()
     {
-        animator.AddFrame("assets\\chest\\frames\\frame-0.png");
-        animator.AddFrame("assets\\chest\\frames\\frame-1.png");
-        animator.AddFrame("assets\\chest\\frames\\frame-2.png");
+        MemoryScope scope(MemoryTag::Textures);
+        AddFrame(animator, "assets\\chest\\frames\\frame-0.png", frameSize);
+        AddFrame(animator, "assets\\chest\\frames\\frame-1.png", frameSize);
+        AddFrame(animator, "assets\\chest\\frames\\frame-2.png", frameSize);
         powerups[PowerupType::Health] = Sprite("assets\\chest\\powerups\\health.png");
         powerups[PowerupType::Speed] = Sprite("assets\\chest\\powerups\\fast-run.png");
         powerups[PowerupType::Shield] = Sprite("assets\\chest\\powerups\\shield.png");
@@ -551,26 +986,66 @@ struct Chest
         elapsedTime = 5.0f;
         animator.Reset();
         animator.SetReverse(true);
+        currPowerup = PowerupType::None;
         chestState= ChestState::Closed;
     }
-    inline void DrawPowerup(Character& character, Window* window)
+    inline void DrawPowerup(Window* window)
     {
-        if(character.currPowerup == PowerupType::None) return;
+        if(currPowerup == PowerupType::None) return;
         float y = pos.y - std::clamp(elapsedTime, 0.0f, 4.0f) * 10.0f;
-        window->DrawSprite(pos.x, y, powerups[character.currPowerup], 3.0f);
+        window->DrawSprite(pos.x, y, powerups[currPowerup], 3.0f);
     }
-    inline void Draw(Character& character, Window* window)
+    inline bool ShowsPrompt(Character& character)
+    {
+        return chestState == ChestState::Closed && Distance(character.pos, pos) < 100.0f && elapsedTime > 5.0f;
+    }
+    inline bool IsIdle(Character& character)
+    {
+        return chestState == ChestState::Closed && animator.HasFinishedPlaying() &&
+            currPowerup == PowerupType::None && !ShowsPrompt(character);
+    }
+    inline Rect<float> GetBounds(Window* window)
     {
-        if(chestState== ChestState::Closed && Distance(character.pos, pos) < 100.0f && elapsedTime > 5.0f)
+        Rect<float> bounds = CenteredBounds(pos, frameSize * 3.0f);
+        bounds = Union(bounds, TextBounds(window, pos.x - 100.0f, pos.y - 60.0f, "Press E to open.", 1.5f));
+        for(auto& powerup : powerups)
+        {
+            const vec2 halfExtent = vec2(powerup.second.width, powerup.second.height) * 1.5f;
+            bounds = Union(bounds, CenteredBounds(pos, halfExtent));
+            bounds = Union(bounds, CenteredBounds(pos - vec2(0.0f, 40.0f), halfExtent));
+        }
+        return bounds;
+    }
+    inline void Draw(Character& character, Window* window, LayerCompositor& compositor)
+    {
+        const Rect<float> bounds = GetBounds(window);
+        const bool idle = IsIdle(character);
+        if(!compositor.BeginStatic(window, bounds, !idle)) return;
+        if(!idle) compositor.MarkDynamic(bounds);
+        window->SetPixelMode(PixelMode::Alpha);
+
+        if(ShowsPrompt(character))
             window->DrawText(pos.x - 100.0f, pos.y - 60.0f, "Press E to open.", 1.5f, Colors::White);
         
+#ifdef INSTANCED_SPRITES
+        if(!instancedBatch)
+#endif
         window->DrawSprite(pos, animator.GetImage(), 6.0f);
         
-        DrawPowerup(character, window);
+        DrawPowerup(window);
+    }
+#ifdef INSTANCED_SPRITES
+    inline void DrawBody(Window* window, LayerCompositor& compositor)
+    {
+        DrawEntitySprite(window, animator.GetImage(), &animator, pos, 6.0f);
     }
-    inline void Update(Character& character, Window* window)
+    inline void Enqueue(DrawQueue& queue)
+    {
+        if(instancedBatch) queue.Push<Chest, &Chest::DrawBody>(DrawLayer::Entities, &animator, pos.y, CenteredBounds(pos, frameSize * 3.0f), *this);
+    }
+#endif
+    inline void Update(Character& character, const InputState& input, float dt)
     {
-        const float dt = window->GetDeltaTime();
         switch(chestState)
         {
             case ChestState::Opening: 
@@ -578,7 +1053,8 @@ struct Chest
                 animator.Update(dt);
                 if(animator.HasFinishedPlaying())
                 {
-                    character.currPowerup = (PowerupType)random(0, 4);
+                    currPowerup = (PowerupType)RandomInt(rng, 0, 4);
+                    character.modifiers.Add(GetPowerupModifier(currPowerup, powerupDuration));
                     chestState= ChestState::Open;
                 } 
             }
@@ -587,7 +1063,7 @@ struct Chest
             {
                 animator.Update(dt);
                 elapsedTime += dt;
-                if(elapsedTime > 5.0f && window->GetKey(GLFW_KEY_E) == Key::Pressed && Distance(character.pos, pos) < 100.0f) 
+                if(elapsedTime > 5.0f && input.IsPressed(GLFW_KEY_E) && Distance(character.pos, pos) < 100.0f) 
                 {
                     elapsedTime = 0.0f;
                     animator.Reverse();
@@ -598,11 +1074,11 @@ struct Chest
             case ChestState::Open:
             {
                 elapsedTime += dt;
-                if(elapsedTime > 10.0f) 
+                if(elapsedTime > powerupDuration) 
                 {
                     elapsedTime = 0.0f;
                     animator.Reverse();
-                    character.currPowerup = PowerupType::None;
+                    currPowerup = PowerupType::None;
                     chestState= ChestState::Closed;
                 }
             } 
@@ -632,6 +1108,7 @@ struct Market
     float size = 1.0f;
     inline void Deserialize(DataNode& datanode)
     {
+        MemoryScope scope(MemoryTag::Textures);
         datanode["items"].ForeachNode([&](std::pair<std::string, DataNode> p){
             itemIndices.push_back(p.first);
             items[p.first].desc = GetString(p.second["desc"], 0).value();
@@ -650,20 +1127,23 @@ struct Market
         for(auto& item : items)
             datanode.get()["items"][item.first]["current index"].SetData<int>(item.second.currLevel, 0);
     }
-    inline void Update(Character& character, Window* window)
+    inline bool Update(Character& character, const InputState& input)
     {
-        if(window->GetKey(GLFW_KEY_A) == Key::Pressed) currItemIndex += (--currItemIndex < 0) ? items.size() : 0;
-        if(window->GetKey(GLFW_KEY_D) == Key::Pressed) currItemIndex = (++currItemIndex) % items.size();
+        bool purchased = false;
+        if(input.IsPressed(GLFW_KEY_A)) currItemIndex += (--currItemIndex < 0) ? items.size() : 0;
+        if(input.IsPressed(GLFW_KEY_D)) currItemIndex = (++currItemIndex) % items.size();
 
-        if(window->GetKey(GLFW_KEY_ENTER) == Key::Pressed)
+        if(input.IsPressed(GLFW_KEY_ENTER))
         {
             const int price = GetPrice();
             if(price != 0 && character.coins >= price)
             {
                 items[itemIndices[currItemIndex]].currLevel++;
                 character.coins -= price;
+                purchased = true;
             }
         }
+        return purchased;
     }
     inline void Draw(Character& character, Window* window)
     {
@@ -694,9 +1174,134 @@ struct Market
     }
     inline void ResetCharacter(Character& character)
     {
-        character.speed = items["speed"].GetPower();
-        character.maxHealth = items["health"].GetPower();
-        character.coinMultiplier = items["money"].GetPower();
+        character.modifiers.Clear(ModifierSource::Market);
+        character.modifiers.Add({Stat::Speed, items["speed"].GetPower()});
+        character.modifiers.Add({Stat::MaxHealth, items["health"].GetPower()});
+        character.modifiers.Add({Stat::CoinsPerKill, items["money"].GetPower()});
+        character.stats = character.modifiers.Fold();
+    }
+};
+
+
+struct IdleRenderer
+{
+    std::vector<int> watchedKeys =
+    {
+        GLFW_KEY_W, GLFW_KEY_A, GLFW_KEY_S, GLFW_KEY_D,
+        GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT,
+        GLFW_KEY_ENTER, GLFW_KEY_SPACE, GLFW_KEY_ESCAPE, GLFW_KEY_F3
+    };
+    double timeout = 0.25;
+    bool dirty = true;
+    bool wasActive = false;
+    bool redrawn = false;
+    inline void Invalidate()
+    {
+        dirty = true;
+    }
+    inline bool AnyKeyActive(Window* window)
+    {
+        for(int key : watchedKeys)
+        {
+            const Key state = window->GetKey(key);
+            if(state == Key::Pressed || state == Key::Held) return true;
+        }
+        return false;
+    }
+    inline bool BeginFrame(Window* window)
+    {
+        const bool active = AnyKeyActive(window);
+        if(active || wasActive) dirty = true;
+        wasActive = active;
+        redrawn = dirty;
+        dirty = false;
+        return redrawn;
+    }
+    inline void Wait()
+    {
+        if(dirty || redrawn || wasActive) return;
+        glfwWaitEventsTimeout(timeout);
+    }
+};
+
+
+inline bool IsCompleteFile(const std::string& path)
+{
+    std::error_code error;
+    const std::uintmax_t size = std::filesystem::file_size(path, error);
+    if(error || size == 0) return false;
+    const std::filesystem::path dir = std::filesystem::absolute(path, error).parent_path();
+    const std::filesystem::space_info space = std::filesystem::space(dir, error);
+    return !error && space.available > 0;
+}
+
+inline bool SaveAtomically(DataNode& datanode, const std::string& path)
+{
+    const std::string tempPath = path + ".tmp";
+    std::error_code error;
+    std::filesystem::remove(tempPath, error);
+    Serialize(datanode, tempPath);
+    bool saved = IsCompleteFile(tempPath);
+    if(saved)
+    {
+        std::filesystem::rename(tempPath, path, error);
+        saved = !error;
+    }
+    if(!saved) std::filesystem::remove(tempPath, error);
+    return saved;
+}
+
+struct SaveWorker
+{
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::optional<DataNode> pending;
+    std::string path;
+    bool running = false;
+    inline void Start(const std::string& path)
+    {
+        Stop();
+        this->path = path;
+        running = true;
+        thread = std::thread(&SaveWorker::Run, this);
+    }
+    inline void Submit(const DataNode& snapshot)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = snapshot;
+        }
+        condition.notify_one();
+    }
+    inline void Stop()
+    {
+        if(!thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        condition.notify_one();
+        thread.join();
+    }
+    inline void Run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true)
+        {
+            condition.wait(lock, [this](){return pending.has_value() || !running;});
+            if(!pending.has_value()) return;
+            DataNode snapshot = std::move(pending.value());
+            pending.reset();
+            lock.unlock();
+            if(!SaveAtomically(snapshot, path))
+                std::cerr << "Autosave to " << path << " failed, keeping the previous save.\n";
+            lock.lock();
+        }
+    }
+    ~SaveWorker()
+    {
+        Stop();
     }
 };
 
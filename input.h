@@ -0,0 +1,103 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "custom-game-engine/headers/includes.h"
+#include <array>
+#include <vector>
+
+struct InputEvent
+{
+    int code;
+    int action;
+    bool mouse;
+};
+
+struct InputState
+{
+    std::array<bool, GLFW_KEY_LAST + 1> keysHeld = {};
+    std::array<bool, GLFW_KEY_LAST + 1> keysPressed = {};
+    std::array<bool, GLFW_MOUSE_BUTTON_LAST + 1> buttonsHeld = {};
+    std::array<bool, GLFW_MOUSE_BUTTON_LAST + 1> buttonsPressed = {};
+    inline bool IsHeld(int key) const
+    {
+        return keysHeld[key];
+    }
+    inline bool IsPressed(int key) const
+    {
+        return keysPressed[key];
+    }
+    inline bool IsButtonHeld(int button) const
+    {
+        return buttonsHeld[button];
+    }
+    inline bool IsButtonPressed(int button) const
+    {
+        return buttonsPressed[button];
+    }
+    inline void BeginTick()
+    {
+        keysPressed.fill(false);
+        buttonsPressed.fill(false);
+    }
+    inline void Apply(const InputEvent& event)
+    {
+        if(event.action == GLFW_REPEAT) return;
+        const bool down = event.action == GLFW_PRESS;
+        if(event.mouse)
+        {
+            if(event.code < 0 || event.code > GLFW_MOUSE_BUTTON_LAST) return;
+            buttonsPressed[event.code] = buttonsPressed[event.code] || down;
+            buttonsHeld[event.code] = down;
+        }
+        else
+        {
+            if(event.code < 0 || event.code > GLFW_KEY_LAST) return;
+            keysPressed[event.code] = keysPressed[event.code] || down;
+            keysHeld[event.code] = down;
+        }
+    }
+};
+
+struct InputSampler
+{
+    static inline InputSampler* instance = nullptr;
+    std::vector<InputEvent> events;
+    GLFWkeyfun prevKeyCallback = nullptr;
+    GLFWmousebuttonfun prevMouseCallback = nullptr;
+    InputState state;
+    inline void Attach(GLFWwindow* handle)
+    {
+        instance = this;
+        prevKeyCallback = glfwSetKeyCallback(handle, &InputSampler::KeyCallback);
+        prevMouseCallback = glfwSetMouseButtonCallback(handle, &InputSampler::MouseButtonCallback);
+    }
+    inline const InputState& Poll()
+    {
+        state.BeginTick();
+        for(auto& event : events) state.Apply(event);
+        events.clear();
+        return state;
+    }
+    static inline void KeyCallback(GLFWwindow* handle, int key, int scancode, int action, int mods)
+    {
+        if(instance)
+        {
+            instance->events.push_back({key, action, false});
+            if(instance->prevKeyCallback) instance->prevKeyCallback(handle, key, scancode, action, mods);
+        }
+    }
+    static inline void MouseButtonCallback(GLFWwindow* handle, int button, int action, int mods)
+    {
+        if(instance)
+        {
+            instance->events.push_back({button, action, true});
+            if(instance->prevMouseCallback) instance->prevMouseCallback(handle, button, action, mods);
+        }
+    }
+    ~InputSampler()
+    {
+        if(instance == this) instance = nullptr;
+    }
+};
+
+#endif
@@ -0,0 +1,320 @@
+#ifndef INSTANCED_H
+#define INSTANCED_H
+
+#include "custom-game-engine/headers/includes.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct SpriteInstance
+{
+    float x, y, halfWidth, halfHeight;
+    float u0, v0, u1, v1;
+    float r, g, b, a;
+    float rotation;
+};
+
+struct InstancedDrawCommand
+{
+    GLuint texture;
+    uint32_t first;
+    uint32_t count;
+};
+
+constexpr const char* instancedVertexShader = R"(
+#version 330 core
+layout(location = 0) in vec4 aPosSize;
+layout(location = 1) in vec4 aUV;
+layout(location = 2) in vec4 aTint;
+layout(location = 3) in float aRotation;
+uniform vec2 uScreenSize;
+out vec2 vUV;
+out vec4 vTint;
+void main()
+{
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 local = (corner * 2.0 - 1.0) * aPosSize.zw;
+    float c = cos(aRotation), s = sin(aRotation);
+    vec2 world = aPosSize.xy + vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+    vec2 ndc = world / uScreenSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    vUV = mix(aUV.xy, aUV.zw, corner);
+    vTint = aTint;
+}
+)";
+
+constexpr const char* instancedFragmentShader = R"(
+#version 330 core
+in vec2 vUV;
+in vec4 vTint;
+uniform sampler2D uTexture;
+out vec4 fragColor;
+void main()
+{
+    fragColor = texture(uTexture, vUV) * vTint;
+}
+)";
+
+inline GLuint CompileInstancedShader(GLenum type, const char* source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint status = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if(!status)
+    {
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+inline GLuint CreateSpriteTexture(int width, int height, const void* pixels)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+struct AtlasFrame
+{
+    GLuint texture;
+    std::array<float, 4> uvRect;
+};
+
+struct SpriteAtlas
+{
+    static constexpr int padding = 1;
+    int size = 0;
+    int cursorX = 0, cursorY = 0, rowHeight = 0;
+    GLuint texture = 0;
+    std::unordered_map<const Sprite*, AtlasFrame> frames;
+    inline bool Add(const Sprite& sprite, AtlasFrame& frame)
+    {
+        if(cursorX + sprite.width > size)
+        {
+            cursorX = 0;
+            cursorY += rowHeight + padding;
+            rowHeight = 0;
+        }
+        if(sprite.width > size || cursorY + sprite.height > size) return false;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, cursorX, cursorY, sprite.width, sprite.height, GL_RGBA, GL_UNSIGNED_BYTE, sprite.data.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        const float scale = 1.0f / size;
+        frame = {texture, {cursorX * scale, cursorY * scale, (cursorX + sprite.width) * scale, (cursorY + sprite.height) * scale}};
+        cursorX += sprite.width + padding;
+        rowHeight = std::max(rowHeight, sprite.height);
+        return true;
+    }
+};
+
+struct InstancedSpriteBatch
+{
+    static constexpr uint32_t sectionCount = 3;
+    uint32_t capacity = 0;
+    bool persistent = false;
+    GLuint program = 0, vao = 0, buffer = 0;
+    GLint screenSizeLoc = -1, textureLoc = -1;
+    std::array<GLsync, sectionCount> fences = {};
+    uint32_t currSection = 0;
+    SpriteInstance* mapped = nullptr;
+    SpriteInstance* sectionBase = nullptr;
+    uint32_t count = 0;
+    std::vector<InstancedDrawCommand> commands;
+    std::unordered_map<const void*, SpriteAtlas> atlases;
+    std::unordered_map<const Sprite*, GLuint> textures;
+    int atlasSize = 1024;
+    vec2 screenSize;
+    int drawCalls = 0;
+    inline bool Init(const vec2& screenSize, uint32_t capacity = 65536)
+    {
+        this->screenSize = screenSize;
+        this->capacity = capacity;
+        GLuint vs = CompileInstancedShader(GL_VERTEX_SHADER, instancedVertexShader);
+        GLuint fs = CompileInstancedShader(GL_FRAGMENT_SHADER, instancedFragmentShader);
+        if(!vs || !fs) return false;
+        program = glCreateProgram();
+        glAttachShader(program, vs);
+        glAttachShader(program, fs);
+        glLinkProgram(program);
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if(!linked) return false;
+        screenSizeLoc = glGetUniformLocation(program, "uScreenSize");
+        textureLoc = glGetUniformLocation(program, "uTexture");
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        persistent = major > 4 || (major == 4 && minor >= 4);
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        const GLsizeiptr size = sizeof(SpriteInstance) * capacity * sectionCount;
+        if(persistent)
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+            mapped = static_cast<SpriteInstance*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+            persistent = mapped != nullptr;
+        }
+        if(!persistent) glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return true;
+    }
+    inline void Begin()
+    {
+        if(sectionBase) return;
+        if(fences[currSection])
+        {
+            GLenum status;
+            do status = glClientWaitSync(fences[currSection], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            while(status == GL_TIMEOUT_EXPIRED);
+            if(status == GL_WAIT_FAILED) glFinish();
+            glDeleteSync(fences[currSection]);
+            fences[currSection] = nullptr;
+        }
+        if(persistent) sectionBase = mapped + capacity * currSection;
+        else
+        {
+            const GLintptr offset = sizeof(SpriteInstance) * capacity * currSection;
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+            sectionBase = static_cast<SpriteInstance*>(glMapBufferRange(GL_ARRAY_BUFFER, offset, sizeof(SpriteInstance) * capacity, flags));
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+    }
+    inline AtlasFrame GetFrame(const void* atlasKey, const Sprite& sprite)
+    {
+        SpriteAtlas& atlas = atlases[atlasKey];
+        auto it = atlas.frames.find(&sprite);
+        if(it != atlas.frames.end()) return it->second;
+        if(!atlas.texture)
+        {
+            atlas.size = atlasSize;
+            atlas.texture = CreateSpriteTexture(atlasSize, atlasSize, nullptr);
+        }
+        AtlasFrame frame;
+        if(!atlas.Add(sprite, frame))
+        {
+            GLuint& texture = textures[&sprite];
+            if(!texture) texture = CreateSpriteTexture(sprite.width, sprite.height, sprite.data.data());
+            frame = {texture, {0.0f, 0.0f, 1.0f, 1.0f}};
+        }
+        atlas.frames[&sprite] = frame;
+        return frame;
+    }
+    inline void Submit(const void* atlasKey, const Sprite& sprite, const vec2& pos, float scale, bool flipped,
+        const Color& tint = Color(255, 255, 255, 255), float rotation = 0.0f)
+    {
+        if(count == capacity) Flush();
+        Begin();
+        if(!sectionBase) return;
+        const AtlasFrame frame = GetFrame(atlasKey, sprite);
+        const float halfWidth = sprite.width * scale * 0.5f;
+        sectionBase[count] =
+        {
+            pos.x, pos.y, flipped ? -halfWidth : halfWidth, sprite.height * scale * 0.5f,
+            frame.uvRect[0], frame.uvRect[1], frame.uvRect[2], frame.uvRect[3],
+            tint.r / 255.0f, tint.g / 255.0f, tint.b / 255.0f, tint.a / 255.0f,
+            rotation
+        };
+        if(!commands.empty() && commands.back().texture == frame.texture) commands.back().count++;
+        else commands.push_back({frame.texture, count, 1});
+        count++;
+    }
+    inline void BindAttributes(uint32_t first)
+    {
+        const GLsizei stride = sizeof(SpriteInstance);
+        const std::size_t base = sizeof(SpriteInstance) * (capacity * currSection + first);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(base));
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(base + sizeof(float) * 4));
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(base + sizeof(float) * 8));
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(base + sizeof(float) * 12));
+    }
+    inline void Flush()
+    {
+        if(!sectionBase) return;
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        if(!persistent) glUnmapBuffer(GL_ARRAY_BUFFER);
+        if(!commands.empty())
+        {
+            glUseProgram(program);
+            glUniform2f(screenSizeLoc, screenSize.x, screenSize.y);
+            glUniform1i(textureLoc, 0);
+            glActiveTexture(GL_TEXTURE0);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glBindVertexArray(vao);
+            for(GLuint i = 0; i < 4; i++)
+            {
+                glEnableVertexAttribArray(i);
+                glVertexAttribDivisor(i, 1);
+            }
+            for(auto& command : commands)
+            {
+                BindAttributes(command.first);
+                glBindTexture(GL_TEXTURE_2D, command.texture);
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, command.count);
+                drawCalls++;
+            }
+            glBindVertexArray(0);
+            glUseProgram(0);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        fences[currSection] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        currSection = (currSection + 1) % sectionCount;
+        sectionBase = nullptr;
+        commands.clear();
+        count = 0;
+    }
+    ~InstancedSpriteBatch()
+    {
+        for(auto& fence : fences)
+            if(fence) glDeleteSync(fence);
+        for(auto& atlas : atlases)
+            if(atlas.second.texture) glDeleteTextures(1, &atlas.second.texture);
+        for(auto& texture : textures) glDeleteTextures(1, &texture.second);
+        if(buffer) glDeleteBuffers(1, &buffer);
+        if(vao) glDeleteVertexArrays(1, &vao);
+        if(program) glDeleteProgram(program);
+    }
+};
+
+inline InstancedSpriteBatch* instancedBatch = nullptr;
+
+template <typename S> inline bool DrawAnimation(Window* window, StateMachine<Sprite, S>& stateMachine, const void* atlasKey,
+    const vec2& pos, float scale, bool facesRight)
+{
+    if(instancedBatch)
+    {
+        instancedBatch->Submit(atlasKey, stateMachine.GetImage(), pos, scale, !facesRight);
+        return false;
+    }
+    stateMachine.Draw(window, pos, scale, 0.0f, facesRight ? 0 : Flip::Horizontal);
+    return true;
+}
+
+inline bool DrawEntitySprite(Window* window, Sprite& sprite, const void* atlasKey, const vec2& pos, float scale)
+{
+    if(instancedBatch)
+    {
+        instancedBatch->Submit(atlasKey, sprite, pos, scale, false);
+        return false;
+    }
+    window->DrawSprite(pos.x, pos.y, sprite, scale);
+    return true;
+}
+
+#endif
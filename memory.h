@@ -0,0 +1,258 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+
+enum class MemoryTag : uint8_t
+{
+    General,
+    Enemies,
+    Animation,
+    Textures,
+    UI,
+    Config,
+    Count
+};
+
+constexpr std::size_t memoryTagCount = static_cast<std::size_t>(MemoryTag::Count);
+
+inline const char* GetMemoryTagName(MemoryTag tag)
+{
+    switch(tag)
+    {
+        case MemoryTag::General: return "general";
+        case MemoryTag::Enemies: return "enemies";
+        case MemoryTag::Animation: return "animation";
+        case MemoryTag::Textures: return "textures";
+        case MemoryTag::UI: return "ui";
+        case MemoryTag::Config: return "config";
+        default: return "unknown";
+    }
+}
+
+struct MemoryStats
+{
+    std::atomic<int64_t> liveBytes{0};
+    std::atomic<int64_t> peakBytes{0};
+    std::atomic<int64_t> totalBytes{0};
+    std::atomic<int64_t> allocCount{0};
+    std::atomic<int64_t> freeCount{0};
+};
+
+struct MemoryTracker
+{
+    std::array<MemoryStats, memoryTagCount> stats;
+    std::array<int64_t, memoryTagCount> ceilings = {};
+    std::array<float, memoryTagCount> allocRates = {};
+    std::array<int64_t, memoryTagCount> lastTotalBytes = {};
+    std::array<int64_t, memoryTagCount> baselineBytes = {};
+    std::array<int64_t, memoryTagCount> baselineAllocs = {};
+    float elapsedTime = 0.0f;
+    inline void Allocate(MemoryTag tag, std::size_t size)
+    {
+        MemoryStats& s = stats[static_cast<std::size_t>(tag)];
+        const int64_t live = s.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        s.totalBytes.fetch_add(size, std::memory_order_relaxed);
+        s.allocCount.fetch_add(1, std::memory_order_relaxed);
+        int64_t peak = s.peakBytes.load(std::memory_order_relaxed);
+        while(live > peak && !s.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+    }
+    inline void Free(MemoryTag tag, std::size_t size)
+    {
+        MemoryStats& s = stats[static_cast<std::size_t>(tag)];
+        s.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+        s.freeCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    inline int64_t GetLiveBytes(MemoryTag tag) const
+    {
+        return stats[static_cast<std::size_t>(tag)].liveBytes.load(std::memory_order_relaxed);
+    }
+    inline float GetAllocRate(MemoryTag tag) const
+    {
+        return allocRates[static_cast<std::size_t>(tag)];
+    }
+    inline void SetCeiling(MemoryTag tag, int64_t bytes)
+    {
+        ceilings[static_cast<std::size_t>(tag)] = bytes;
+    }
+    inline bool ExceedsCeiling(MemoryTag tag) const
+    {
+        const std::size_t index = static_cast<std::size_t>(tag);
+        return ceilings[index] > 0 && stats[index].peakBytes.load(std::memory_order_relaxed) > ceilings[index];
+    }
+    inline int64_t GetOutstanding(MemoryTag tag) const
+    {
+        const MemoryStats& s = stats[static_cast<std::size_t>(tag)];
+        return s.allocCount.load(std::memory_order_relaxed) - s.freeCount.load(std::memory_order_relaxed);
+    }
+    inline void MarkBaseline()
+    {
+        for(std::size_t i = 0; i < memoryTagCount; i++)
+        {
+            baselineBytes[i] = GetLiveBytes(static_cast<MemoryTag>(i));
+            baselineAllocs[i] = GetOutstanding(static_cast<MemoryTag>(i));
+        }
+    }
+    inline void Update(float delta)
+    {
+        elapsedTime += delta;
+        if(elapsedTime < 1.0f) return;
+        for(std::size_t i = 0; i < memoryTagCount; i++)
+        {
+            const int64_t total = stats[i].totalBytes.load(std::memory_order_relaxed);
+            allocRates[i] = (total - lastTotalBytes[i]) / elapsedTime;
+            lastTotalBytes[i] = total;
+        }
+        elapsedTime = 0.0f;
+    }
+    inline bool WriteReport(const std::string& path) const
+    {
+        std::array<int64_t, memoryTagCount> leakedBytes, leakedAllocs;
+        for(std::size_t i = 0; i < memoryTagCount; i++)
+        {
+            leakedBytes[i] = GetLiveBytes(static_cast<MemoryTag>(i)) - baselineBytes[i];
+            leakedAllocs[i] = GetOutstanding(static_cast<MemoryTag>(i)) - baselineAllocs[i];
+        }
+        bool passed = true;
+        std::ofstream file(path);
+        file << "tag live peak total allocs frees leaked_bytes leaked_allocs ceiling\n";
+        for(std::size_t i = 0; i < memoryTagCount; i++)
+        {
+            const MemoryTag tag = static_cast<MemoryTag>(i);
+            const MemoryStats& s = stats[i];
+            file << GetMemoryTagName(tag) << ' ' << s.liveBytes.load() << ' ' << s.peakBytes.load() << ' '
+                << s.totalBytes.load() << ' ' << s.allocCount.load() << ' ' << s.freeCount.load() << ' '
+                << leakedBytes[i] << ' ' << leakedAllocs[i] << ' ' << ceilings[i];
+            if(leakedAllocs[i] > 0)
+            {
+                file << " LEAKED";
+                passed = false;
+            }
+            if(ExceedsCeiling(tag))
+            {
+                file << " EXCEEDED";
+                passed = false;
+            }
+            file << '\n';
+        }
+        return passed;
+    }
+};
+
+inline MemoryTracker memoryTracker;
+inline thread_local MemoryTag currentMemoryTag = MemoryTag::General;
+
+struct MemoryScope
+{
+    MemoryTag prevTag;
+    MemoryScope(MemoryTag tag) : prevTag(currentMemoryTag)
+    {
+        currentMemoryTag = tag;
+    }
+    ~MemoryScope()
+    {
+        currentMemoryTag = prevTag;
+    }
+};
+
+struct TrackedDeleter
+{
+    MemoryTag tag = MemoryTag::General;
+    std::size_t size = 0;
+    template <typename T> inline void operator()(T* ptr) const
+    {
+        if(!ptr) return;
+#ifndef TRACK_ALLOCATIONS
+        memoryTracker.Free(tag, size);
+#endif
+        delete ptr;
+    }
+};
+
+template <typename T> using TrackedPtr = std::unique_ptr<T, TrackedDeleter>;
+
+template <typename T, typename... Args> inline TrackedPtr<T> MakeTracked(MemoryTag tag, Args&&... args)
+{
+    MemoryScope scope(tag);
+    T* ptr = new T(std::forward<Args>(args)...);
+#ifndef TRACK_ALLOCATIONS
+    memoryTracker.Allocate(tag, sizeof(T));
+#endif
+    return TrackedPtr<T>(ptr, TrackedDeleter{tag, sizeof(T)});
+}
+
+#ifdef TRACK_ALLOCATIONS
+
+struct AllocationHeader
+{
+    std::size_t size;
+    MemoryTag tag;
+};
+
+constexpr std::size_t allocationHeaderSize =
+    (sizeof(AllocationHeader) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+inline void* TrackedAllocate(std::size_t size, MemoryTag tag = currentMemoryTag) noexcept
+{
+    void* block = std::malloc(size + allocationHeaderSize);
+    if(!block) return nullptr;
+    AllocationHeader* header = static_cast<AllocationHeader*>(block);
+    header->size = size;
+    header->tag = tag;
+    memoryTracker.Allocate(header->tag, size);
+    return static_cast<char*>(block) + allocationHeaderSize;
+}
+
+inline void* TrackedReallocate(void* ptr, std::size_t size) noexcept
+{
+    if(!ptr) return TrackedAllocate(size, MemoryTag::Textures);
+    AllocationHeader* header = reinterpret_cast<AllocationHeader*>(static_cast<char*>(ptr) - allocationHeaderSize);
+    const AllocationHeader prev = *header;
+    void* block = std::realloc(header, size + allocationHeaderSize);
+    if(!block) return nullptr;
+    header = static_cast<AllocationHeader*>(block);
+    header->size = size;
+    memoryTracker.Free(prev.tag, prev.size);
+    memoryTracker.Allocate(prev.tag, size);
+    return static_cast<char*>(block) + allocationHeaderSize;
+}
+
+inline void TrackedFree(void* ptr) noexcept
+{
+    if(!ptr) return;
+    AllocationHeader* header = reinterpret_cast<AllocationHeader*>(static_cast<char*>(ptr) - allocationHeaderSize);
+    memoryTracker.Free(header->tag, header->size);
+    std::free(header);
+}
+
+void* operator new(std::size_t size)
+{
+    if(void* ptr = TrackedAllocate(size)) return ptr;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size)
+{
+    if(void* ptr = TrackedAllocate(size)) return ptr;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return TrackedAllocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return TrackedAllocate(size); }
+void operator delete(void* ptr) noexcept { TrackedFree(ptr); }
+void operator delete[](void* ptr) noexcept { TrackedFree(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { TrackedFree(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { TrackedFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { TrackedFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { TrackedFree(ptr); }
+
+#endif
+
+#endif
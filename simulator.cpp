@@ -0,0 +1,234 @@
+#define STB_IMAGE_IMPLEMENTATION
+#define NO_COLLISIONS
+#define VERTEX_COLOR
+#include "game.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+struct SimConfig
+{
+    int runs = 1000;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    float delta = 1.0f / 60.0f;
+    float maxTime = 600.0f;
+    uint32_t seed = 1;
+    bool binary = false;
+    std::string configPath = "datafile.txt";
+    std::string outPath = "simulation.csv";
+    std::vector<std::pair<std::string, int>> levels;
+};
+
+struct RunResult
+{
+    int32_t run;
+    uint32_t seed;
+    int32_t wave;
+    int32_t coins;
+    int32_t ticks;
+    float simTime;
+    float meanTickMicros;
+    float maxTickMicros;
+};
+
+struct BotPolicy
+{
+    inline InputState Decide(Character& character, WaveSystem& waves, Chest& chest)
+    {
+        InputState input;
+        vec2 target = character.pos;
+        float nearest = std::numeric_limits<float>::max();
+        waves.enemies.Foreach([&](auto& pool)
+        {
+            for(auto& enemy : pool)
+            {
+                if(enemy.health <= 0.0f) continue;
+                const float dist = Distance(enemy.pos, character.pos);
+                if(dist < nearest)
+                {
+                    nearest = dist;
+                    target = enemy.pos;
+                }
+            }
+        });
+        if(nearest < 90.0f)
+        {
+            input.buttonsPressed[GLFW_MOUSE_BUTTON_1] = true;
+            return input;
+        }
+        if(nearest == std::numeric_limits<float>::max())
+        {
+            if(chest.ShowsPrompt(character)) input.keysPressed[GLFW_KEY_E] = true;
+            if(chest.chestState == Chest::ChestState::Closed) target = chest.pos;
+        }
+        const vec2 dir = target - character.pos;
+        if(dir.x < -10.0f) input.keysHeld[GLFW_KEY_A] = true;
+        if(dir.x > 10.0f) input.keysHeld[GLFW_KEY_D] = true;
+        if(dir.y < -10.0f) input.keysHeld[GLFW_KEY_W] = true;
+        if(dir.y > 10.0f) input.keysHeld[GLFW_KEY_S] = true;
+        return input;
+    }
+};
+
+struct SimInstance
+{
+    Character character;
+    WaveSystem waves;
+    Chest chest;
+    Market market;
+    BotPolicy policy;
+    inline RunResult Run(int run, uint32_t seed, const SimConfig& config)
+    {
+        using Clock = std::chrono::steady_clock;
+        waves.rng.seed(seed);
+        chest.rng.seed(seed ^ 0x9E3779B9u);
+        market.ResetCharacter(character);
+        character.SetDefault();
+        character.coins = 0;
+        waves.Reset();
+        chest.Reset();
+        RunResult result = {run, seed, 0, 0, 0, 0.0f, 0.0f, 0.0f};
+        double totalMicros = 0.0;
+        while(character.health > 0 && result.simTime < config.maxTime)
+        {
+            const auto start = Clock::now();
+            const InputState input = policy.Decide(character, waves, chest);
+            character.Update(input, config.delta);
+            waves.Update(config.delta, character);
+            chest.Update(character, input, config.delta);
+            const float micros = std::chrono::duration<float, std::micro>(Clock::now() - start).count();
+            totalMicros += micros;
+            result.maxTickMicros = std::max(result.maxTickMicros, micros);
+            result.simTime += config.delta;
+            result.ticks++;
+        }
+        result.wave = waves.currentWave;
+        result.coins = character.coins;
+        result.meanTickMicros = result.ticks > 0 ? totalMicros / result.ticks : 0.0f;
+        return result;
+    }
+};
+
+struct ResultLog
+{
+    std::mutex mutex;
+    std::FILE* file = nullptr;
+    bool binary = false;
+    inline bool Open(const std::string& path, bool binary)
+    {
+        this->binary = binary;
+        file = std::fopen(path.c_str(), binary ? "wb" : "w");
+        if(file && !binary) std::fprintf(file, "run,seed,wave,coins,ticks,sim_time,mean_tick_us,max_tick_us\n");
+        return file != nullptr;
+    }
+    inline void Write(const RunResult& result)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(binary) std::fwrite(&result, sizeof(RunResult), 1, file);
+        else std::fprintf(file, "%d,%u,%d,%d,%d,%.3f,%.3f,%.3f\n", result.run, result.seed, result.wave, result.coins,
+            result.ticks, result.simTime, result.meanTickMicros, result.maxTickMicros);
+    }
+    ~ResultLog()
+    {
+        if(file) std::fclose(file);
+    }
+};
+
+inline bool ParseArgs(int argc, char** argv, SimConfig& config)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if(arg == "--binary")
+        {
+            config.binary = true;
+            continue;
+        }
+        if(i + 1 >= argc) return false;
+        const std::string value = argv[++i];
+        if(arg == "--runs") config.runs = std::stoi(value);
+        else if(arg == "--threads") config.threads = std::max(1, std::stoi(value));
+        else if(arg == "--dt") config.delta = std::stof(value);
+        else if(arg == "--max-time") config.maxTime = std::stof(value);
+        else if(arg == "--seed") config.seed = std::stoul(value);
+        else if(arg == "--config") config.configPath = value;
+        else if(arg == "--out") config.outPath = value;
+        else if(arg == "--level")
+        {
+            const std::size_t split = value.find('=');
+            if(split == std::string::npos) return false;
+            config.levels.emplace_back(value.substr(0, split), std::stoi(value.substr(split + 1)));
+        }
+        else return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    SimConfig config;
+    bool parsed = false;
+    try
+    {
+        parsed = ParseArgs(argc, argv, config);
+    }
+    catch(const std::logic_error&) {}
+    if(!parsed)
+    {
+        std::cerr << "usage: simulator [--runs N] [--threads N] [--dt S] [--max-time S] [--seed N]"
+            " [--config datafile.txt] [--out simulation.csv] [--binary] [--level item=N]...\n";
+        return 1;
+    }
+    DataNode datanode;
+    Deserialize(datanode, config.configPath);
+    Market market;
+    market.Deserialize(datanode);
+    for(auto& level : config.levels)
+    {
+        auto item = market.items.find(level.first);
+        if(item == market.items.end())
+        {
+            std::cerr << "unknown market item: " << level.first << '\n';
+            return 1;
+        }
+        if(item->second.data.empty())
+        {
+            std::cerr << "market item has no levels: " << level.first << '\n';
+            return 1;
+        }
+        item->second.currLevel = std::clamp<int>(level.second, 1, item->second.data.size());
+    }
+    ResultLog log;
+    if(!log.Open(config.outPath, config.binary))
+    {
+        std::cerr << "could not open " << config.outPath << '\n';
+        return 1;
+    }
+    std::atomic<int> nextRun{0};
+    std::atomic<int64_t> totalTicks{0}, totalWaves{0}, totalCoins{0};
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for(int i = 0; i < config.threads; i++)
+        workers.emplace_back([&]()
+        {
+            TrackedPtr<SimInstance> instance = MakeTracked<SimInstance>(MemoryTag::General);
+            instance->market = market;
+            for(int run = nextRun++; run < config.runs; run = nextRun++)
+            {
+                const RunResult result = instance->Run(run, config.seed + run * 7919u, config);
+                totalTicks += result.ticks;
+                totalWaves += result.wave;
+                totalCoins += result.coins;
+                log.Write(result);
+            }
+        });
+    for(auto& worker : workers) worker.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double runs = std::max(config.runs, 1);
+    std::cout << config.runs << " runs on " << config.threads << " threads in " << seconds << "s, "
+        << totalTicks / std::max(seconds, 1e-9) << " ticks/s, mean wave " << totalWaves / runs
+        << ", mean coins " << totalCoins / runs << '\n';
+    return 0;
+}